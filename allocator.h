@@ -1,11 +1,28 @@
 #pragma once
 
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstring>
 #include <stdexcept>
 #include <cstdint>
 #include <cstdlib>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/* Type used by allocators to store sizes and links of their metadata as offsets from the beginning of the managed memory.
+ * Define ALLOCATOR_COMPACT_METADATA to use 32-bit offsets, which halves the size of free nodes and allocation headers, but limits the managed memory to less than 4 GiB.
+ */
+#ifdef ALLOCATOR_COMPACT_METADATA
+using offset_t = uint32_t;
+#else
+using offset_t = size_t;
+#endif
 
 
 /* @brief Abstract base class for allocators used to manage a large portion of memory.
@@ -29,23 +46,33 @@ public:
         mTotalMemory {totalMemory}, 
         mUsedMemory {0}, 
         mMaxUsedMemory {0},
-        pParent {parent}
+        pParent {parent},
+        mOwnsMemory {true}
     {
         assert(totalMemory > 0);
+        assert(totalMemory < NullOffset);
         
+        // Large zeroed blocks come as fresh pages from the system, so calloc does not need to touch them
         if (!pParent)
         {
-            pBase = std::malloc(mTotalMemory);
+            pBase = std::calloc(1, mTotalMemory);
+            mZeroedMemory = true;
         }
         else
         {
             pBase = pParent->Allocate(mTotalMemory, sizeof(max_align_t));
+            mZeroedMemory = false;
         }
     }
 
     /* @brief Default destructor that frees the allocated memory.
      */
-    ~IAllocator() {
+    virtual ~IAllocator() {
+
+        if (!mOwnsMemory)
+        {
+            return;
+        }
 
         if (!pParent)
         {
@@ -61,6 +88,109 @@ public:
     virtual void  Free(void* ptr) = 0;
     virtual void  Clear() = 0;
 
+    /* @brief Allocates a section of memory like Allocate(), but reports running out of memory by returning nullptr instead of throwing.
+     * The default implementation catches the std::overflow_error of Allocate(), derived allocators may fail without an exception.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * @return Pointer to the allocated memory, nullptr if the allocation failed.
+     */
+    virtual void* TryAllocate(const size_t size, const size_t align = 1) {
+
+        try
+        {
+            return Allocate(size, align);
+        }
+        catch (const std::overflow_error&)
+        {
+            return nullptr;
+        }
+    }
+
+    /* @brief Allocates a section of memory that is filled with zeros.
+     * The default implementation clears the whole section, derived allocators only clear the parts not already known to be zero.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * @return Pointer to the allocated memory.
+     */
+    virtual void* AllocateZeroed(const size_t size, const size_t align = 1) {
+
+        void *mem = Allocate(size, align);
+        ZeroMemory(mem, size);
+
+        return mem;
+    }
+
+    /* @brief Returns the usable size of an allocated memory section, which may be larger than the requested size.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * 
+     * @return The size of the memory section in bytes.
+     */
+    virtual size_t AllocatedSize(const void* /*ptr*/) const {
+
+        throw std::logic_error("Allocator does not track the size of allocations.");
+    }
+
+    /* @brief Tries to resize an allocated memory section in place, without moving it.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * @param newSize    The requested new size in bytes.
+     * 
+     * @return True if the memory section at ptr now holds at least newSize bytes.
+     */
+    virtual bool TryExpand(void* /*ptr*/, const size_t /*newSize*/) {
+
+        return false;
+    }
+
+    /* @brief Resizes an allocated memory section, in place if possible or by allocating a new section, copying the content and freeing the old section.
+     * Moving a section needs its size, allocators without AllocatedSize() throw std::logic_error and leave the section untouched.
+     *
+     * @param ptr    Pointer to the allocated memory section, if nullptr a new section is allocated.
+     * @param newSize    The requested new size in bytes.
+     * @param align    The alignment of the memory section. Must be non-zero and a power of two.
+     * 
+     * @return Pointer to the resized memory section.
+     */
+    virtual void* Reallocate(void* ptr, const size_t newSize, const size_t align = 1) {
+
+        if (!ptr)
+        {
+            return Allocate(newSize, align);
+        }
+
+        if ((reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0 && TryExpand(ptr, newSize))
+        {
+            return ptr;
+        }
+
+        // Asked first, so allocators that do not track sizes throw before anything is allocated
+        size_t oldSize = AllocatedSize(ptr);
+        void *mem = Allocate(newSize, align);
+        std::memcpy(mem, ptr, std::min(oldSize, newSize));
+        Free(ptr);
+
+        return mem;
+    }
+
+    /* @brief Checks if a pointer lies inside the managed memory space.
+     *
+     * @param ptr    Pointer to check.
+     * 
+     * @return True if ptr points into the managed memory space.
+     */
+    virtual bool Owns(const void* ptr) const {
+
+        uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        uintptr_t baseAddress = reinterpret_cast<uintptr_t>(pBase);
+
+        return address >= baseAddress && address < baseAddress + mTotalMemory;
+    }
+
     /* @brief Initialize new object of type T.
      *
      * @param args    Argument list for constructor.
@@ -124,6 +254,7 @@ public:
     }
 
 
+    const void* base()      const { return pBase;}
     size_t  totalMemory()   const { return mTotalMemory;}
     size_t  usedMemory()    const { return mUsedMemory;}
     size_t  maxUsedMemory() const { return mMaxUsedMemory;}
@@ -131,6 +262,76 @@ public:
 
 protected:
 
+    /* @brief Constructor for allocators that manage a memory portion owned by someone else, which is not freed on destruction.
+     *
+     * @param base    Pointer to the beginning of the memory portion, may be nullptr for allocators that only forward to other allocators.
+     * @param totalMemory    The size of the memory portion in bytes.
+     */
+    IAllocator(void *base, const size_t totalMemory) :
+        pParent {nullptr},
+        pBase {base},
+        mOwnsMemory {false},
+        mZeroedMemory {false},
+        mTotalMemory {totalMemory}, 
+        mUsedMemory {0}, 
+        mMaxUsedMemory {0}
+    {
+    }
+
+    /* @brief Converts a pointer into the managed memory to an offset from pBase.
+     *
+     * @param ptr    Pointer into the managed memory or nullptr.
+     * 
+     * @return The offset of ptr, NullOffset for nullptr.
+     */
+    offset_t ToOffset(const void* ptr) const {
+
+        return ptr ? static_cast<offset_t>(reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(pBase)) : NullOffset;
+    }
+
+    /* @brief Converts an offset from pBase to a pointer into the managed memory.
+     *
+     * @param offset    Offset from pBase or NullOffset.
+     * 
+     * @return Pointer at offset, nullptr for NullOffset.
+     */
+    template<typename T>
+    T* FromOffset(const offset_t offset) const {
+
+        return offset != NullOffset ? reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(pBase) + offset) : nullptr;
+    }
+
+    /* @brief Fills a memory section with zeros, bypassing the cache with non-temporal stores for large sections.
+     *
+     * @param ptr    Pointer to the memory section.
+     * @param size    The size of the memory section in bytes.
+     */
+    static void ZeroMemory(void* ptr, const size_t size) {
+
+#if defined(__SSE2__)
+        if (size >= NonTemporalThreshold)
+        {
+            uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+            uintptr_t end = address + size;
+            uintptr_t alignedAddress = (address + 15) & ~uintptr_t{15};
+            uintptr_t alignedEnd = end & ~uintptr_t{15};
+
+            std::memset(ptr, 0, alignedAddress - address);
+            __m128i zero = _mm_setzero_si128();
+            for (uintptr_t curr = alignedAddress; curr < alignedEnd; curr += 16)
+            {
+                _mm_stream_si128(reinterpret_cast<__m128i*>(curr), zero);
+            }
+            _mm_sfence();
+            std::memset(reinterpret_cast<void*>(alignedEnd), 0, end - alignedEnd);
+
+            return;
+        }
+#endif
+
+        std::memset(ptr, 0, size);
+    }
+
     /* @brief Calculates the adjustment in bytes to properly align a given memory address
      *
      * @param address    The memory address to align.
@@ -151,12 +352,24 @@ protected:
     }
 
 
+    // Offset representing a nullptr
+    static constexpr offset_t NullOffset = std::numeric_limits<offset_t>::max();
+
+    // Sections of at least this size are zeroed with non-temporal stores, so they do not evict the cache
+    static constexpr size_t NonTemporalThreshold = 256 * 1024;
+
     // Poiner to a parent allocator, nullptr by default
     IAllocator *pParent;
 
     // Pointer to the beginning of the allocated memory
     void* pBase;
 
+    // False if the memory portion was provided externally and must not be freed
+    bool mOwnsMemory;
+
+    // True if the memory portion was filled with zeros when the allocator took it over
+    bool mZeroedMemory;
+
     size_t mTotalMemory;
     size_t mUsedMemory;
     size_t mMaxUsedMemory;
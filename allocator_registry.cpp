@@ -0,0 +1,204 @@
+#include "allocator_registry.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+
+namespace {
+
+    // 48 bit addresses with 4 KiB pages leave 36 bits of page number, split into three levels of 12 bits
+    constexpr size_t PageShift = 12;
+    constexpr size_t LevelBits = 12;
+    constexpr size_t LevelSize = size_t{1} << LevelBits;
+    constexpr uintptr_t MaxPageNumber = uintptr_t{1} << (3 * LevelBits);
+
+    // Marks a page shared by more than one allocator
+    IAllocator* const SharedPage = reinterpret_cast<IAllocator*>(uintptr_t{1});
+
+    struct Leaf {
+
+        std::atomic<IAllocator*> owners[LevelSize];
+    };
+
+    struct Node {
+
+        std::atomic<Leaf*> leaves[LevelSize];
+    };
+
+    struct PageMap {
+
+        std::atomic<Node*> nodes[LevelSize];
+        std::vector<IAllocator*> allocators;
+        std::mutex mutex;
+    };
+
+    PageMap& pageMap() {
+
+        static PageMap *map = new PageMap();
+        return *map;
+    }
+
+    /* @brief Returns the owner entry of a page, optionally creating the tree levels on the way.
+     */
+    std::atomic<IAllocator*>* findEntry(PageMap &map, uintptr_t pageNumber, bool create) {
+
+        if (pageNumber >= MaxPageNumber)
+        {
+            if (create)
+            {
+                throw std::out_of_range("Allocator memory lies outside of the 48 bit address space.");
+            }
+            return nullptr;
+        }
+
+        std::atomic<Node*> &nodeSlot = map.nodes[pageNumber >> (2 * LevelBits)];
+        Node *node = nodeSlot.load(std::memory_order_acquire);
+        if (!node)
+        {
+            if (!create)
+            {
+                return nullptr;
+            }
+            node = new Node();
+            nodeSlot.store(node, std::memory_order_release);
+        }
+
+        std::atomic<Leaf*> &leafSlot = node->leaves[(pageNumber >> LevelBits) & (LevelSize - 1)];
+        Leaf *leaf = leafSlot.load(std::memory_order_acquire);
+        if (!leaf)
+        {
+            if (!create)
+            {
+                return nullptr;
+            }
+            leaf = new Leaf();
+            leafSlot.store(leaf, std::memory_order_release);
+        }
+
+        return &leaf->owners[pageNumber & (LevelSize - 1)];
+    }
+
+    /* @brief Returns the registered allocators overlapping [begin, end), innermost first, as nested allocators lie inside their parent.
+     */
+    std::vector<IAllocator*> overlapping(const PageMap &map, uintptr_t begin, uintptr_t end) {
+
+        std::vector<IAllocator*> allocators;
+        for (IAllocator *allocator : map.allocators)
+        {
+            uintptr_t allocatorBegin = reinterpret_cast<uintptr_t>(allocator->base());
+            if (allocatorBegin < end && allocatorBegin + allocator->totalMemory() > begin)
+            {
+                allocators.push_back(allocator);
+            }
+        }
+
+        std::stable_sort(allocators.begin(), allocators.end(), [](const IAllocator *a, const IAllocator *b) {
+
+            return a->totalMemory() < b->totalMemory();
+        });
+
+        return allocators;
+    }
+
+    /* @brief Recomputes the owner of all pages in [begin, end) from the registered allocators overlapping them.
+     * A page belongs to the innermost allocator covering all of it, unless an allocator nested in that one or next to it starts or ends within the page.
+     */
+    void updatePages(PageMap &map, uintptr_t begin, uintptr_t end) {
+
+        std::vector<IAllocator*> candidates = overlapping(map, begin, end);
+
+        for (uintptr_t page = begin >> PageShift; page <= (end - 1) >> PageShift; page++)
+        {
+            uintptr_t pageBegin = page << PageShift;
+            uintptr_t pageEnd = pageBegin + (uintptr_t{1} << PageShift);
+
+            IAllocator *owner = nullptr;
+            for (IAllocator *allocator : candidates)
+            {
+                uintptr_t allocatorBegin = reinterpret_cast<uintptr_t>(allocator->base());
+                uintptr_t allocatorEnd = allocatorBegin + allocator->totalMemory();
+                if (allocatorBegin >= pageEnd || allocatorEnd <= pageBegin)
+                {
+                    continue;
+                }
+
+                // Candidates are sorted innermost first, the first one covering the whole page hides all outer ones
+                bool coversPage = allocatorBegin <= pageBegin && allocatorEnd >= pageEnd;
+                owner = owner ? SharedPage : allocator;
+                if (coversPage || owner == SharedPage)
+                {
+                    break;
+                }
+            }
+
+            findEntry(map, page, true)->store(owner, std::memory_order_release);
+        }
+    }
+}
+
+
+void AllocatorRegistry::Register(IAllocator *allocator) {
+
+    assert(allocator && allocator->base() && allocator->totalMemory() > 0);
+
+    PageMap &map = pageMap();
+    std::lock_guard<std::mutex> lock(map.mutex);
+
+    map.allocators.push_back(allocator);
+    updatePages(map, reinterpret_cast<uintptr_t>(allocator->base()), reinterpret_cast<uintptr_t>(allocator->base()) + allocator->totalMemory());
+}
+
+void AllocatorRegistry::Unregister(IAllocator *allocator) {
+
+    PageMap &map = pageMap();
+    std::lock_guard<std::mutex> lock(map.mutex);
+
+    auto pos = std::find(map.allocators.begin(), map.allocators.end(), allocator);
+    if (pos == map.allocators.end())
+    {
+        return;
+    }
+
+    // Pages of a nested allocator fall back to its parent if that is still registered
+    map.allocators.erase(pos);
+    updatePages(map, reinterpret_cast<uintptr_t>(allocator->base()), reinterpret_cast<uintptr_t>(allocator->base()) + allocator->totalMemory());
+}
+
+IAllocator* AllocatorRegistry::OwnerOf(const void* ptr) {
+
+    PageMap &map = pageMap();
+
+    std::atomic<IAllocator*> *entry = findEntry(map, reinterpret_cast<uintptr_t>(ptr) >> PageShift, false);
+    IAllocator *owner = entry ? entry->load(std::memory_order_acquire) : nullptr;
+
+    if (owner == SharedPage)
+    {
+        std::lock_guard<std::mutex> lock(map.mutex);
+        uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+        for (IAllocator *allocator : overlapping(map, address, address + 1))
+        {
+            if (allocator->Owns(ptr))
+            {
+                return allocator;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The page may only partially belong to the owner
+    return owner && owner->Owns(ptr) ? owner : nullptr;
+}
+
+void AllocatorRegistry::Free(void* ptr) {
+
+    IAllocator *owner = OwnerOf(ptr);
+    if (!owner)
+    {
+        throw std::invalid_argument("Pointer is not owned by any registered allocator.");
+    }
+
+    owner->Free(ptr);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+
+#include "allocator.h"
+
+
+/* @brief Global registry resolving the allocator that owns a pointer, so memory can be freed without knowing where it came from.
+ * 
+ * Maps every page of the managed memory of registered allocators to its allocator with a three level radix tree over the page number.
+ * Lookups are lock free and take three dependent loads, registration is serialized by a mutex.
+ * Allocators created with a parent lie inside the memory of the parent, a page belongs to the innermost allocator covering all of it,
+ * regardless of the order of registration. Pages shared by allocators at the border of their memory portions are resolved by asking
+ * the registered allocators, innermost first. Unregistering an allocator hands its pages back to the allocators still registered.
+ * Only the managed memory portion is mapped, allocations FreeTreeAllocator maps directly (see SetDirectMapThreshold()) are not found.
+ * Tree levels are allocated on first use and kept for the lifetime of the process.
+ * 
+ * Allocators must be unregistered before they are destroyed.
+ * 
+ * @class 
+ */
+class AllocatorRegistry {
+
+public:
+
+    AllocatorRegistry() = delete;
+
+    /* @brief Maps all pages of the managed memory of an allocator to it.
+     *
+     * @param allocator    The allocator to register, must manage its own memory portion.
+     */
+    static void Register(IAllocator *allocator);
+
+    /* @brief Removes an allocator from the registry.
+     *
+     * @param allocator    The allocator to unregister.
+     */
+    static void Unregister(IAllocator *allocator);
+
+    /* @brief Finds the registered allocator owning a pointer.
+     *
+     * @param ptr    Pointer to look up.
+     * 
+     * @return The owning allocator, nullptr if no registered allocator owns ptr.
+     */
+    static IAllocator* OwnerOf(const void* ptr);
+
+    /* @brief Frees memory with the registered allocator owning it.
+     * Throws std::invalid_argument if no registered allocator owns ptr.
+     *
+     * @param ptr    Pointer to the memory to free.
+     */
+    static void Free(void* ptr);
+};
@@ -0,0 +1,151 @@
+#include "bitmap_pool_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+BitmapPoolAllocator::BitmapPoolAllocator(const size_t totalMemory, const size_t chunkSize, IAllocator *parent) :
+    IAllocator(totalMemory, parent),
+    mChunkSize {chunkSize}
+{
+    assert(totalMemory % chunkSize == 0);
+
+    mNumChunks = totalMemory / chunkSize;
+    mFreeBits.resize((mNumChunks + 63) / 64);
+    mSummaryBits.resize((mFreeBits.size() + 63) / 64);
+    mZeroedAddress = reinterpret_cast<uintptr_t>(pBase) + (mZeroedMemory ? 0 : mTotalMemory);
+    Clear();
+}
+
+BitmapPoolAllocator::~BitmapPoolAllocator() {
+
+}
+
+void* BitmapPoolAllocator::Allocate(const size_t size, const size_t align) {
+
+    assert(size <= mChunkSize);
+    assert(mChunkSize % align == 0);
+
+    size_t summaryIndex = FindSummaryWord();
+    if (summaryIndex == mSummaryBits.size())
+    {
+        throw std::overflow_error("Bitmap pool allocator is out of memory!");
+    }
+    mSummaryHint = summaryIndex;
+
+    size_t wordIndex = 64 * summaryIndex + __builtin_ctzll(mSummaryBits[summaryIndex]);
+    uint64_t &word = mFreeBits[wordIndex];
+    size_t chunkIndex = 64 * wordIndex + __builtin_ctzll(word);
+
+    // Clear lowest set bit and the summary bit if the word is now full
+    word &= word - 1;
+    if (word == 0)
+    {
+        mSummaryBits[summaryIndex] &= ~(uint64_t{1} << (wordIndex % 64));
+    }
+
+    mUsedMemory += mChunkSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + chunkIndex * mChunkSize;
+    mZeroedAddress = std::max(mZeroedAddress, address + mChunkSize);
+
+    return reinterpret_cast<void*>(address);
+}
+
+void* BitmapPoolAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    uintptr_t zeroedAddress = mZeroedAddress;
+    void *mem = Allocate(size, align);
+
+    if (reinterpret_cast<uintptr_t>(mem) < zeroedAddress)
+    {
+        ZeroMemory(mem, mChunkSize);
+    }
+
+    return mem;
+}
+
+void BitmapPoolAllocator::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+    assert(IsAllocated(ptr));
+
+    size_t chunkIndex = (reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(pBase)) / mChunkSize;
+    size_t wordIndex = chunkIndex / 64;
+    size_t summaryIndex = wordIndex / 64;
+
+    mFreeBits[wordIndex] |= uint64_t{1} << (chunkIndex % 64);
+    mSummaryBits[summaryIndex] |= uint64_t{1} << (wordIndex % 64);
+    mSummaryHint = std::min(mSummaryHint, summaryIndex);
+
+    mUsedMemory -= mChunkSize;
+}
+
+void BitmapPoolAllocator::Clear() {
+
+    std::fill(mFreeBits.begin(), mFreeBits.end(), ~uint64_t{0});
+    if (mNumChunks % 64 != 0)
+    {
+        mFreeBits.back() = (uint64_t{1} << (mNumChunks % 64)) - 1;
+    }
+
+    std::fill(mSummaryBits.begin(), mSummaryBits.end(), ~uint64_t{0});
+    if (mFreeBits.size() % 64 != 0)
+    {
+        mSummaryBits.back() = (uint64_t{1} << (mFreeBits.size() % 64)) - 1;
+    }
+
+    mSummaryHint = 0;
+    mUsedMemory = 0;
+}
+
+size_t BitmapPoolAllocator::AllocatedSize(const void* /*ptr*/) const {
+
+    return mChunkSize;
+}
+
+bool BitmapPoolAllocator::TryExpand(void* /*ptr*/, const size_t newSize) {
+
+    return newSize <= mChunkSize;
+}
+
+bool BitmapPoolAllocator::IsAllocated(const void* ptr) const {
+
+    assert(Owns(ptr));
+
+    size_t chunkIndex = (reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(pBase)) / mChunkSize;
+
+    return (mFreeBits[chunkIndex / 64] & (uint64_t{1} << (chunkIndex % 64))) == 0;
+}
+
+size_t BitmapPoolAllocator::FindSummaryWord() const {
+
+    size_t index = mSummaryHint;
+    size_t numWords = mSummaryBits.size();
+
+#if defined(__AVX2__)
+    // Skip four zero words at a time
+    for (; index + 4 <= numWords; index += 4)
+    {
+        __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mSummaryBits.data() + index));
+        if (!_mm256_testz_si256(words, words))
+        {
+            break;
+        }
+    }
+#endif
+
+    for (; index < numWords; index++)
+    {
+        if (mSummaryBits[index])
+        {
+            return index;
+        }
+    }
+
+    return numWords;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <vector>
+
+
+/* @brief Bitmap pool implementation of IAllocator.
+ * 
+ * Splits the managed memory space into chunks of equal size and keeps track of free chunks with a bitmap, one bit per chunk, and a summary bitmap, one bit per bitmap word.
+ * Allocates new memory from the free chunk with the lowest address, found by scanning the summary bitmap and counting trailing zeros.
+ * Frees memory by setting the bit of the chunk, the memory of freed chunks is never written to.
+ * Clears all allocations by setting all bits of the bitmap.
+ * 
+ * @class 
+ */
+class BitmapPoolAllocator : public IAllocator{
+
+public:
+
+    BitmapPoolAllocator() = delete;
+
+    /* @brief Constructor that allocates the managed memory portion and splits it into chunks. Creates the bitmaps to track free chunks.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes.
+     * @param chunkSize    The size of each allocatable memory region.
+     * @param parent    Optional parent allocator to get memory from.
+     */
+    explicit BitmapPoolAllocator(const size_t totalMemory, const size_t chunkSize, IAllocator *parent = nullptr);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~BitmapPoolAllocator();
+    
+    /* @brief Allocates the free chunk with the lowest address. 
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Allocates a zero filled chunk, clearing it only if it lies below the highest chunk ever handed out.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
+    /* @brief Frees the allocated chunk at ptr by marking it as free in the bitmap.
+     * 
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Frees all the allocated memory by marking all chunks as free.
+     */
+    void  Clear() override;
+
+    /* @brief Returns the chunk size, which is the usable size of every allocation.
+     *
+     * @param ptr    Pointer to the allocated chunk.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Succeeds if the new size still fits into the chunk.
+     *
+     * @param ptr    Pointer to the allocated chunk.
+     * @param newSize    The requested new size in bytes.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Checks if the chunk at ptr is currently allocated.
+     *
+     * @param ptr    Pointer to the chunk.
+     */
+    bool IsAllocated(const void* ptr) const;
+
+    /* @brief Calls func for every allocated chunk in address order, e.g. to destroy or serialize all live objects.
+     *
+     * @param func    Callable taking the void* pointer of a chunk.
+     */
+    template<typename Func>
+    void ForEachAllocated(Func func) const;
+
+
+private:
+
+    /* @brief Searches the summary bitmap for the first word with a bit set, starting at mSummaryHint.
+     *
+     * @return Index of the summary word, or the number of summary words if all chunks are allocated.
+     */
+    size_t FindSummaryWord() const;
+
+
+    // Bit i of word w is set if chunk 64 * w + i is free
+    std::vector<uint64_t> mFreeBits;
+    // Bit i of word w is set if mFreeBits[64 * w + i] has any bit set
+    std::vector<uint64_t> mSummaryBits;
+    // All summary words below the hint are zero
+    size_t mSummaryHint;
+    size_t mChunkSize;
+    size_t mNumChunks;
+    // All memory from this address on is known to be zero
+    uintptr_t mZeroedAddress;
+};
+
+
+template<typename Func>
+void BitmapPoolAllocator::ForEachAllocated(Func func) const {
+
+    uintptr_t baseAddress = reinterpret_cast<uintptr_t>(pBase);
+    for (size_t w = 0; w < mFreeBits.size(); w++)
+    {
+        uint64_t allocatedBits = ~mFreeBits[w];
+        // Mask out the bits beyond the last chunk
+        if (w == mFreeBits.size() - 1 && mNumChunks % 64 != 0)
+        {
+            allocatedBits &= (uint64_t{1} << (mNumChunks % 64)) - 1;
+        }
+
+        while (allocatedBits)
+        {
+            size_t index = 64 * w + __builtin_ctzll(allocatedBits);
+            func(reinterpret_cast<void*>(baseAddress + index * mChunkSize));
+            allocatedBits &= allocatedBits - 1;
+        }
+    }
+}
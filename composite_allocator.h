@@ -0,0 +1,470 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <new>
+#include <tuple>
+#include <utility>
+
+
+/* Header-only building blocks to compose allocators at compile time.
+ *
+ * A composable allocator is any type providing Allocate(size, align), Free(ptr), Clear(), Owns(ptr), usedMemory() and totalMemory().
+ * All allocators derived from IAllocator qualify. Composites hold their parts by value, so the dynamic type of every part is known
+ * and calls into it are resolved statically and can be inlined, e.g.
+ *
+ *     Segregator<256, PoolAllocator, FreeTreeAllocator> alloc(std::piecewise_construct, std::forward_as_tuple(MB, 256), std::forward_as_tuple(10*MB));
+ *
+ * AllocatorAdapter turns any composite back into an IAllocator where type erasure is wanted.
+ */
+
+
+/* @brief CRTP base providing New and Delete for single objects and arrays to statically composed allocators.
+ *
+ * @class
+ */
+template<typename Derived>
+class StaticAllocator {
+
+public:
+
+    /* @brief Initialize new object of type T.
+     *
+     * @param args    Argument list for constructor.
+     *
+     * @return Pointer to the initialized object.
+     */
+    template<typename T, typename... Args>
+    T* New(Args&&... args) {
+
+        void *mem = derived().Allocate(sizeof(T), alignof(T));
+        return new (mem) T(std::forward<Args>(args)...);
+    }
+
+    /* @brief Initialize new array of type T.
+     *
+     * @param length    Number of elements in the array.
+     *
+     * @return Pointer to the initialized array.
+     */
+    template<typename T>
+    T* NewArr(const size_t length) {
+
+        assert(length > 0);
+
+        T *mem = static_cast<T*>(derived().Allocate(length * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < length; i++)
+        {
+            new (mem + i) T();
+        }
+
+        return mem;
+    }
+
+    /* @brief Delete object of type T.
+     *
+     * @param obj    Pointer to the object that should be deleted.
+     */
+    template<typename T>
+    void Delete(T* obj) {
+
+        obj->~T();
+        derived().Free(static_cast<void*>(obj));
+    }
+
+    /* @brief Delete array of type T.
+     *
+     * @param arr    Pointer to the array that should be deleted.
+     * @param length    Number of elements in the array.
+     */
+    template<typename T>
+    void DeleteArr(T* arr, const size_t length) {
+
+        assert(length > 0);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            arr[i].~T();
+        }
+
+        derived().Free(static_cast<void*>(arr));
+    }
+
+
+private:
+
+    Derived& derived() { return static_cast<Derived&>(*this);}
+};
+
+
+/* @brief Tries to allocate from Primary and falls back to Secondary if Primary is out of memory.
+ *
+ * Frees memory to the allocator owning the pointer.
+ *
+ * @class
+ */
+template<typename Primary, typename Secondary>
+class Fallback : public StaticAllocator<Fallback<Primary, Secondary>> {
+
+public:
+
+    /* @brief Constructor that constructs both allocators in place from the given argument tuples.
+     *
+     * @param primaryArgs    Constructor arguments of the primary allocator.
+     * @param secondaryArgs    Constructor arguments of the secondary allocator.
+     */
+    template<typename... PrimaryArgs, typename... SecondaryArgs>
+    Fallback(std::piecewise_construct_t, std::tuple<PrimaryArgs...> primaryArgs, std::tuple<SecondaryArgs...> secondaryArgs) :
+        mPrimary {std::make_from_tuple<Primary>(std::move(primaryArgs))},
+        mSecondary {std::make_from_tuple<Secondary>(std::move(secondaryArgs))}
+    {
+    }
+
+    void* Allocate(const size_t size, const size_t align = 1) {
+
+        try
+        {
+            return mPrimary.Allocate(size, align);
+        }
+        catch(const std::overflow_error& e)
+        {
+            return mSecondary.Allocate(size, align);
+        }
+    }
+
+    void Free(void* ptr) {
+
+        if (mPrimary.Owns(ptr))
+        {
+            mPrimary.Free(ptr);
+        }
+        else
+        {
+            mSecondary.Free(ptr);
+        }
+    }
+
+    void Clear() {
+
+        mPrimary.Clear();
+        mSecondary.Clear();
+    }
+
+    bool Owns(const void* ptr) const { return mPrimary.Owns(ptr) || mSecondary.Owns(ptr);}
+
+    size_t  totalMemory()   const { return mPrimary.totalMemory() + mSecondary.totalMemory();}
+    size_t  usedMemory()    const { return mPrimary.usedMemory() + mSecondary.usedMemory();}
+
+    Primary&    primary()   { return mPrimary;}
+    Secondary&  secondary() { return mSecondary;}
+
+
+private:
+
+    Primary mPrimary;
+    Secondary mSecondary;
+};
+
+
+/* @brief Routes allocations of up to Threshold bytes to Small and all larger allocations to Large.
+ *
+ * @class
+ */
+template<size_t Threshold, typename Small, typename Large>
+class Segregator : public StaticAllocator<Segregator<Threshold, Small, Large>> {
+
+public:
+
+    /* @brief Constructor that constructs both allocators in place from the given argument tuples.
+     *
+     * @param smallArgs    Constructor arguments of the allocator for small sizes.
+     * @param largeArgs    Constructor arguments of the allocator for large sizes.
+     */
+    template<typename... SmallArgs, typename... LargeArgs>
+    Segregator(std::piecewise_construct_t, std::tuple<SmallArgs...> smallArgs, std::tuple<LargeArgs...> largeArgs) :
+        mSmall {std::make_from_tuple<Small>(std::move(smallArgs))},
+        mLarge {std::make_from_tuple<Large>(std::move(largeArgs))}
+    {
+    }
+
+    void* Allocate(const size_t size, const size_t align = 1) {
+
+        if (size <= Threshold)
+        {
+            return mSmall.Allocate(size, align);
+        }
+
+        return mLarge.Allocate(size, align);
+    }
+
+    void Free(void* ptr) {
+
+        if (mSmall.Owns(ptr))
+        {
+            mSmall.Free(ptr);
+        }
+        else
+        {
+            mLarge.Free(ptr);
+        }
+    }
+
+    void Clear() {
+
+        mSmall.Clear();
+        mLarge.Clear();
+    }
+
+    bool Owns(const void* ptr) const { return mSmall.Owns(ptr) || mLarge.Owns(ptr);}
+
+    size_t  totalMemory()   const { return mSmall.totalMemory() + mLarge.totalMemory();}
+    size_t  usedMemory()    const { return mSmall.usedMemory() + mLarge.usedMemory();}
+
+    Small&  small() { return mSmall;}
+    Large&  large() { return mLarge;}
+
+
+private:
+
+    Small mSmall;
+    Large mLarge;
+};
+
+
+/* @brief Keeps one allocator of type A per size class of Step bytes in the range (MinSize, MaxSize].
+ *
+ * Each bucket is constructed from (bucketMemory, bucketSize), where bucketSize is the largest size of its class, which matches PoolAllocator.
+ * Allocations outside of the range must be routed elsewhere, e.g. with a Segregator.
+ *
+ * @class
+ */
+template<typename A, size_t MinSize, size_t MaxSize, size_t Step>
+class Bucketizer : public StaticAllocator<Bucketizer<A, MinSize, MaxSize, Step>> {
+
+    static_assert(MinSize < MaxSize && Step > 0 && (MaxSize - MinSize) % Step == 0, "Bucket range must be a multiple of the step size.");
+
+    static constexpr size_t NumBuckets = (MaxSize - MinSize) / Step;
+
+public:
+
+    /* @brief Constructor that creates all buckets.
+     *
+     * @param bucketMemory    The size of the managed memory space of each bucket in bytes.
+     */
+    explicit Bucketizer(const size_t bucketMemory) {
+
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            new (bucket(i)) A(bucketMemory, MinSize + (i + 1) * Step);
+        }
+    }
+
+    /* @brief Destructor that destroys all buckets.
+     */
+    ~Bucketizer() {
+
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            bucket(i)->~A();
+        }
+    }
+
+    Bucketizer(const Bucketizer&) = delete;
+    Bucketizer& operator=(const Bucketizer&) = delete;
+
+    void* Allocate(const size_t size, const size_t align = 1) {
+
+        assert(size > MinSize && size <= MaxSize);
+
+        return bucket((size - MinSize - 1) / Step)->Allocate(size, align);
+    }
+
+    void Free(void* ptr) {
+
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            if (bucket(i)->Owns(ptr))
+            {
+                bucket(i)->Free(ptr);
+                return;
+            }
+        }
+    }
+
+    void Clear() {
+
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            bucket(i)->Clear();
+        }
+    }
+
+    bool Owns(const void* ptr) const {
+
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            if (bucket(i)->Owns(ptr))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    size_t totalMemory() const {
+
+        size_t total = 0;
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            total += bucket(i)->totalMemory();
+        }
+
+        return total;
+    }
+
+    size_t usedMemory() const {
+
+        size_t used = 0;
+        for (size_t i = 0; i < NumBuckets; i++)
+        {
+            used += bucket(i)->usedMemory();
+        }
+
+        return used;
+    }
+
+
+private:
+
+    A*          bucket(const size_t i)       { return std::launder(reinterpret_cast<A*>(mBuckets + i * sizeof(A)));}
+    const A*    bucket(const size_t i) const { return std::launder(reinterpret_cast<const A*>(mBuckets + i * sizeof(A)));}
+
+
+    // Storage for the buckets, which are not copyable and can therefore not be kept in a std::array
+    alignas(A) unsigned char mBuckets[NumBuckets * sizeof(A)];
+};
+
+
+/* @brief Forwards all calls to an allocator of type A and counts allocations, frees and the peak memory usage.
+ *
+ * @class
+ */
+template<typename A>
+class StatsCollector : public StaticAllocator<StatsCollector<A>> {
+
+public:
+
+    /* @brief Constructor that constructs the wrapped allocator in place.
+     *
+     * @param args    Constructor arguments of the wrapped allocator.
+     */
+    template<typename... Args>
+    explicit StatsCollector(Args&&... args) :
+        mAllocator(std::forward<Args>(args)...),
+        mNumAllocations {0},
+        mNumFrees {0},
+        mRequestedMemory {0},
+        mMaxUsedMemory {0}
+    {
+    }
+
+    void* Allocate(const size_t size, const size_t align = 1) {
+
+        void *mem = mAllocator.Allocate(size, align);
+
+        ++mNumAllocations;
+        mRequestedMemory += size;
+        mMaxUsedMemory = std::max(mMaxUsedMemory, mAllocator.usedMemory());
+
+        return mem;
+    }
+
+    void Free(void* ptr) {
+
+        mAllocator.Free(ptr);
+        ++mNumFrees;
+    }
+
+    void Clear() {
+
+        mAllocator.Clear();
+    }
+
+    bool Owns(const void* ptr) const { return mAllocator.Owns(ptr);}
+
+    size_t  totalMemory()       const { return mAllocator.totalMemory();}
+    size_t  usedMemory()        const { return mAllocator.usedMemory();}
+    size_t  maxUsedMemory()     const { return mMaxUsedMemory;}
+    size_t  numAllocations()    const { return mNumAllocations;}
+    size_t  numFrees()          const { return mNumFrees;}
+    size_t  requestedMemory()   const { return mRequestedMemory;}
+
+    A&  allocator() { return mAllocator;}
+
+
+private:
+
+    A mAllocator;
+
+    size_t mNumAllocations;
+    size_t mNumFrees;
+    size_t mRequestedMemory;
+    size_t mMaxUsedMemory;
+};
+
+
+/* @brief Type-erased IAllocator wrapping a statically composed allocator of type A.
+ *
+ * @class
+ */
+template<typename A>
+class AllocatorAdapter : public IAllocator {
+
+public:
+
+    /* @brief Constructor that constructs the wrapped allocator in place.
+     *
+     * @param args    Constructor arguments of the wrapped allocator.
+     */
+    template<typename... Args>
+    explicit AllocatorAdapter(Args&&... args) :
+        IAllocator(nullptr, 0),
+        mAllocator(std::forward<Args>(args)...)
+    {
+        mTotalMemory = mAllocator.totalMemory();
+    }
+
+    void* Allocate(const size_t size, const size_t align = 1) override {
+
+        void *mem = mAllocator.Allocate(size, align);
+
+        mUsedMemory = mAllocator.usedMemory();
+        mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+        return mem;
+    }
+
+    void Free(void* ptr) override {
+
+        mAllocator.Free(ptr);
+        mUsedMemory = mAllocator.usedMemory();
+    }
+
+    void Clear() override {
+
+        mAllocator.Clear();
+        mUsedMemory = mAllocator.usedMemory();
+    }
+
+    bool Owns(const void* ptr) const override { return mAllocator.Owns(ptr);}
+
+    A&  allocator() { return mAllocator;}
+
+
+private:
+
+    A mAllocator;
+};
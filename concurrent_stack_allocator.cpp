@@ -0,0 +1,117 @@
+#include "concurrent_stack_allocator.h"
+#include <stdexcept>
+
+
+namespace {
+
+    // Arena of the calling thread in the allocator it used last
+    struct ThreadArena {
+
+        uint64_t allocator = 0;
+        uint64_t generation = 0;
+        uintptr_t top = 0;
+        uintptr_t end = 0;
+    };
+
+    thread_local ThreadArena tArena;
+
+    std::atomic<uint64_t> sNextId {1};
+
+    // Raises a counter of the base class that several threads may update at once
+    void StoreMax(size_t &counter, const size_t value) {
+
+        size_t current = __atomic_load_n(&counter, __ATOMIC_RELAXED);
+        while (current < value && !__atomic_compare_exchange_n(&counter, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+        }
+    }
+}
+
+
+ConcurrentStackAllocator::ConcurrentStackAllocator(const size_t totalMemory, const size_t arenaSize, IAllocator *parent) :
+    IAllocator(totalMemory, parent),
+    mArenaSize {arenaSize},
+    mId {sNextId.fetch_add(1, std::memory_order_relaxed)},
+    mTopOffset {0},
+    mGeneration {0}
+{
+    assert(arenaSize <= totalMemory);
+
+    Clear();
+}
+
+ConcurrentStackAllocator::~ConcurrentStackAllocator() {
+
+}
+
+void* ConcurrentStackAllocator::Allocate(const size_t size, const size_t align) {
+
+    // Keeps the header in front of the allocation aligned
+    size_t blockAlign = std::max(align, alignof(offset_t));
+
+    uintptr_t alignedAddress;
+    if (mArenaSize == 0 || HeaderSize + size + blockAlign - 1 > mArenaSize / 4)
+    {
+        alignedAddress = AllocateShared(size, blockAlign);
+        *reinterpret_cast<offset_t*>(alignedAddress - HeaderSize) = static_cast<offset_t>(size);
+
+        return reinterpret_cast<void*>(alignedAddress);
+    }
+
+    // Drop the arena if it belongs to another allocator or was cleared
+    ThreadArena &arena = tArena;
+    uint64_t generation = mGeneration.load(std::memory_order_acquire);
+    if (arena.allocator != mId || arena.generation != generation)
+    {
+        arena = {mId, generation, 0, 0};
+    }
+
+    size_t adjustment = getAlignmentAdjustment(arena.top + HeaderSize, blockAlign);
+    if (arena.top == 0 || arena.top + HeaderSize + adjustment + size > arena.end)
+    {
+        // The rest of the old arena is wasted, at most a quarter arena
+        arena.top = AllocateShared(mArenaSize, alignof(max_align_t));
+        arena.end = arena.top + mArenaSize;
+        adjustment = getAlignmentAdjustment(arena.top + HeaderSize, blockAlign);
+    }
+
+    alignedAddress = arena.top + HeaderSize + adjustment;
+    arena.top = alignedAddress + size;
+    *reinterpret_cast<offset_t*>(alignedAddress - HeaderSize) = static_cast<offset_t>(size);
+
+    return reinterpret_cast<void*>(alignedAddress);
+}
+
+void ConcurrentStackAllocator::Free(void* /*ptr*/) {
+
+}
+
+void ConcurrentStackAllocator::Clear() {
+
+    mTopOffset.store(0, std::memory_order_relaxed);
+    mUsedMemory = 0;
+    mGeneration.fetch_add(1, std::memory_order_release);
+}
+
+size_t ConcurrentStackAllocator::AllocatedSize(const void* ptr) const {
+
+    return *reinterpret_cast<const offset_t*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+}
+
+uintptr_t ConcurrentStackAllocator::AllocateShared(const size_t size, const size_t align) {
+
+    // Reserving size + align - 1 bytes behind the header always leaves room to align, so the top only needs one atomic operation
+    size_t reservedSize = HeaderSize + size + align - 1;
+    size_t offset = mTopOffset.fetch_add(reservedSize, std::memory_order_relaxed);
+    if (offset + reservedSize > mTotalMemory)
+    {
+        throw std::overflow_error("Concurrent stack allocator is out of memory!");
+    }
+
+    StoreMax(mUsedMemory, offset + reservedSize);
+    StoreMax(mMaxUsedMemory, offset + reservedSize);
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + offset + HeaderSize;
+
+    return address + getAlignmentAdjustment(address, align);
+}
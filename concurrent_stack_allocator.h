@@ -0,0 +1,89 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <atomic>
+
+
+/* @brief Thread-safe linear implementation of IAllocator for scratch memory shared by parallel workers.
+ *
+ * Allocates new memory by bumping an atomic top of the used memory region with fetch_add, which never blocks.
+ * With a non-zero arena size every thread instead carves private arenas of that size from the shared top and bumps a thread-local top inside its arena,
+ * so allocations do not touch shared cache lines except to take a new arena. Allocations larger than a quarter arena always use the shared top.
+ * Every allocation is preceded by its size, so it can be moved by Reallocate().
+ * Does not free single allocations. Clears all allocations of all threads at once by resetting the shared top and starting a new generation,
+ * threads notice the new generation on their next allocation and drop their arena.
+ * usedMemory() is the memory taken from the shared top, including unused parts of thread arenas, and only exact while no thread allocates.
+ *
+ * Every thread keeps the arena of the last allocator it used, alternating between several allocators in one thread wastes the rest of an arena on every switch.
+ *
+ * @class
+ */
+class ConcurrentStackAllocator : public IAllocator{
+
+public:
+
+    ConcurrentStackAllocator() = delete;
+
+    /* @brief Constructor that allocates the managed memory portion and calls Clear() to reset the shared top.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes.
+     * @param arenaSize    The size of the per-thread arenas in bytes, zero to allocate everything from the shared top.
+     * @param parent    Optional parent allocator to get memory from.
+     */
+    explicit ConcurrentStackAllocator(const size_t totalMemory, const size_t arenaSize = 0, IAllocator *parent = nullptr);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~ConcurrentStackAllocator();
+
+    /* @brief Allocates a properly aligned section of memory from the arena of the calling thread or the shared top. Thread-safe.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Does nothing, memory is only reclaimed by Clear().
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Frees the allocated memory of all threads, e.g. at a request boundary. Must not run concurrently with Allocate().
+     */
+    void  Clear() override;
+
+    /* @brief Returns the size of an allocation as stored in front of it.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    uint64_t generation() const { return mGeneration.load(std::memory_order_relaxed);}
+
+
+private:
+
+    /* @brief Allocates from the shared top with a single fetch_add, reserving room for a header and the worst case alignment padding.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section.
+     *
+     * return Address of the allocated memory.
+     */
+    uintptr_t AllocateShared(const size_t size, const size_t align);
+
+    // Size of the allocation stored in front of it
+    static constexpr size_t HeaderSize = sizeof(offset_t);
+
+    size_t mArenaSize;
+    // Identifies the allocator in the arenas of threads, unlike its address it is never reused
+    uint64_t mId;
+
+    alignas(64) std::atomic<size_t> mTopOffset;
+    alignas(64) std::atomic<uint64_t> mGeneration;
+};
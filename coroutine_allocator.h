@@ -0,0 +1,120 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+
+/* @brief Mixin for C++20 coroutine promise types that allocates the coroutine frame from an IAllocator passed to the coroutine.
+ *
+ * A coroutine whose promise type derives from AllocatorPromise gets its frame from the first parameter that is a reference to an IAllocator,
+ * or to any allocator derived from it, e.g.
+ *
+ *     Task HandleRequest(Request &request, IAllocator &frameAlloc);
+ *
+ * Member function coroutines work the same way, the object parameter is skipped. Coroutines without an allocator parameter use the global heap.
+ * The allocator is stored behind the frame so the frame can be freed without knowing where it came from, the allocator must outlive the frame.
+ * A PoolAllocator must have chunks large enough for the frame and the stored pointer, a StackAllocator requires frames to be destroyed
+ * in reverse order of creation or all at once with Clear(), e.g. at the end of a request.
+ *
+ * @class
+ */
+class AllocatorPromise {
+
+public:
+
+    /* @brief Allocates a coroutine frame, called by the compiler with the frame size followed by the coroutine arguments.
+     *
+     * @param size    The size of the coroutine frame in bytes.
+     * @param args    The arguments of the coroutine, the first reference to an IAllocator is used.
+     *
+     * @return Pointer to the frame memory.
+     */
+    template<typename... Args>
+    [[gnu::always_inline]] static void* operator new(const size_t size, Args&... args) {
+
+        return AllocateFrame(size, FindAllocator(args...));
+    }
+
+    /* @brief Frees a coroutine frame with the allocator stored behind it.
+     *
+     * @param ptr    Pointer to the frame memory.
+     * @param size    The size of the coroutine frame in bytes.
+     */
+    static void operator delete(void* ptr, const size_t size) {
+
+        FreeFrame(ptr, size);
+    }
+
+
+private:
+
+    /* @brief Returns the offset of the stored allocator pointer behind a frame of size bytes.
+     *
+     * @param size    The size of the coroutine frame in bytes.
+     */
+    static constexpr size_t AllocatorOffset(const size_t size) { return (size + alignof(IAllocator*) - 1) & ~(alignof(IAllocator*) - 1);}
+
+    /* @brief Allocates a frame and the stored allocator pointer behind it from allocator or, if it is nullptr, the global heap.
+     * GCC reports a template operator new as mismatched with the non-template operator delete, so operator new is always inlined
+     * and the frame appears to come from this helper, which is paired with FreeFrame().
+     *
+     * @param size    The size of the coroutine frame in bytes.
+     * @param allocator    The allocator to take the frame from, or nullptr.
+     */
+    static void* AllocateFrame(const size_t size, IAllocator *allocator) {
+
+        size_t allocatorOffset = AllocatorOffset(size);
+
+        void *mem = allocator ? allocator->Allocate(allocatorOffset + sizeof(IAllocator*), alignof(std::max_align_t)) : ::operator new(allocatorOffset + sizeof(IAllocator*));
+        *reinterpret_cast<IAllocator**>(reinterpret_cast<uintptr_t>(mem) + allocatorOffset) = allocator;
+
+        return mem;
+    }
+
+    /* @brief Frees a frame allocated by AllocateFrame().
+     *
+     * @param ptr    Pointer to the frame memory.
+     * @param size    The size of the coroutine frame in bytes.
+     */
+    static void FreeFrame(void* ptr, const size_t size) {
+
+        IAllocator *allocator = *reinterpret_cast<IAllocator**>(reinterpret_cast<uintptr_t>(ptr) + AllocatorOffset(size));
+        if (allocator)
+        {
+            allocator->Free(ptr);
+        }
+        else
+        {
+            ::operator delete(ptr);
+        }
+    }
+
+    static IAllocator* FindAllocator() { return nullptr;}
+
+    /* @brief Returns the first argument that is a non-const IAllocator, nullptr if there is none.
+     *
+     * @param first    The first remaining coroutine argument.
+     * @param rest    The other remaining coroutine arguments.
+     */
+    template<typename First, typename... Rest>
+    static IAllocator* FindAllocator(First &first, Rest&... rest) {
+
+        if constexpr (std::is_base_of_v<IAllocator, First> && !std::is_const_v<First>)
+        {
+            return static_cast<IAllocator*>(&first);
+        }
+        else
+        {
+            return FindAllocator(rest...);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "epoch_pool_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+EpochPoolAllocator::EpochPoolAllocator(const size_t totalMemory, const size_t chunkSize, IAllocator *parent) :
+    mPool(totalMemory, chunkSize, parent),
+    mChunkSize {chunkSize},
+    mEpoch {0}
+{
+}
+
+EpochPoolAllocator::~EpochPoolAllocator() {
+
+    assert(mParticipants.empty());
+}
+
+size_t EpochPoolAllocator::usedMemory() {
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPool.usedMemory();
+}
+
+uint64_t EpochPoolAllocator::TryAdvance() {
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // Only called with the mutex held, so the epoch can not change concurrently
+    uint64_t epoch = mEpoch.load(std::memory_order_seq_cst);
+    for (Participant *participant : mParticipants)
+    {
+        uint64_t localEpoch = participant->mLocalEpoch.load(std::memory_order_seq_cst);
+        if ((localEpoch & 1) && (localEpoch >> 1) != epoch)
+        {
+            return epoch;
+        }
+    }
+
+    mEpoch.store(++epoch, std::memory_order_seq_cst);
+
+    // Batches of participants that already left are reclaimed by whoever advances the epoch
+    auto safe = std::partition(mOrphans.begin(), mOrphans.end(), [epoch](const OrphanBatch &batch) { return batch.epoch + 2 > epoch;});
+    for (auto batch = safe; batch != mOrphans.end(); ++batch)
+    {
+        for (void *chunk : batch->chunks)
+        {
+            mPool.Free(chunk);
+        }
+    }
+    mOrphans.erase(safe, mOrphans.end());
+
+    return epoch;
+}
+
+void EpochPoolAllocator::TakeChunks(std::vector<void*> &chunks, const size_t count) {
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (size_t i = 0; i < count && mPool.usedMemory() + mChunkSize <= mPool.totalMemory(); i++)
+    {
+        chunks.push_back(mPool.Allocate(mChunkSize));
+    }
+}
+
+void EpochPoolAllocator::ReturnChunks(std::vector<void*> &chunks, const size_t count) {
+
+    assert(count <= chunks.size());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        mPool.Free(chunks.back());
+        chunks.pop_back();
+    }
+}
+
+
+EpochPoolAllocator::Participant::Participant(EpochPoolAllocator &allocator) :
+    mAllocator {allocator},
+    mLocalEpoch {0},
+    mPinDepth {0},
+    mRetiredEpoch {0, 0, 0},
+    mRetiresSinceReclaim {0}
+{
+    mCache.reserve(3 * BatchSize);
+
+    std::lock_guard<std::mutex> lock(mAllocator.mMutex);
+    mAllocator.mParticipants.push_back(this);
+}
+
+EpochPoolAllocator::Participant::~Participant() {
+
+    assert(!pinned());
+
+    mAllocator.ReturnChunks(mCache, mCache.size());
+
+    std::lock_guard<std::mutex> lock(mAllocator.mMutex);
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (!mRetired[i].empty())
+        {
+            mAllocator.mOrphans.push_back({mRetiredEpoch[i], std::move(mRetired[i])});
+        }
+    }
+
+    auto &participants = mAllocator.mParticipants;
+    participants.erase(std::find(participants.begin(), participants.end(), this));
+}
+
+void EpochPoolAllocator::Participant::Pin() {
+
+    if (mPinDepth++ == 0)
+    {
+        // Readers pinned at an epoch that is already outdated only delay the next advance
+        uint64_t epoch = mAllocator.mEpoch.load(std::memory_order_seq_cst);
+        mLocalEpoch.store((epoch << 1) | 1, std::memory_order_seq_cst);
+    }
+}
+
+void EpochPoolAllocator::Participant::Unpin() {
+
+    assert(mPinDepth > 0);
+
+    if (--mPinDepth == 0)
+    {
+        mLocalEpoch.store(0, std::memory_order_release);
+    }
+}
+
+void* EpochPoolAllocator::Participant::Allocate() {
+
+    if (mCache.empty())
+    {
+        mAllocator.TakeChunks(mCache, BatchSize);
+    }
+    if (mCache.empty())
+    {
+        Reclaim();
+    }
+    if (mCache.empty())
+    {
+        throw std::overflow_error("Epoch pool allocator is out of memory!");
+    }
+
+    void *mem = mCache.back();
+    mCache.pop_back();
+
+    return mem;
+}
+
+void EpochPoolAllocator::Participant::Retire(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    uint64_t epoch = mAllocator.mEpoch.load(std::memory_order_seq_cst);
+
+    // A batch from an older epoch with the same index is at least three epochs old and safe to reuse
+    size_t index = epoch % 3;
+    if (mRetiredEpoch[index] != epoch)
+    {
+        mCache.insert(mCache.end(), mRetired[index].begin(), mRetired[index].end());
+        mRetired[index].clear();
+        mRetiredEpoch[index] = epoch;
+    }
+
+    mRetired[index].push_back(ptr);
+
+    if (++mRetiresSinceReclaim >= BatchSize)
+    {
+        Reclaim();
+    }
+}
+
+void EpochPoolAllocator::Participant::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    mCache.push_back(ptr);
+    TrimCache();
+}
+
+void EpochPoolAllocator::Participant::Reclaim() {
+
+    mRetiresSinceReclaim = 0;
+
+    uint64_t epoch = mAllocator.TryAdvance();
+    ReclaimBatches(epoch);
+    TrimCache();
+}
+
+size_t EpochPoolAllocator::Participant::retiredChunks() const {
+
+    return mRetired[0].size() + mRetired[1].size() + mRetired[2].size();
+}
+
+void EpochPoolAllocator::Participant::ReclaimBatches(const uint64_t epoch) {
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        if (!mRetired[i].empty() && mRetiredEpoch[i] + 2 <= epoch)
+        {
+            mCache.insert(mCache.end(), mRetired[i].begin(), mRetired[i].end());
+            mRetired[i].clear();
+        }
+    }
+}
+
+void EpochPoolAllocator::Participant::TrimCache() {
+
+    if (mCache.size() > 2 * BatchSize)
+    {
+        mAllocator.ReturnChunks(mCache, mCache.size() - BatchSize);
+    }
+}
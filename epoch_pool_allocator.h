@@ -0,0 +1,204 @@
+#pragma once
+
+
+#include "pool_allocator.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+
+/* @brief Pool allocator with epoch based reclamation for nodes of lock-free data structures.
+ *
+ * Threads access the allocator through a Participant each. A participant pins itself while it reads shared nodes,
+ * and retires unlinked nodes instead of freeing them, as concurrent readers may still hold pointers to them.
+ * Retired chunks are kept in one batch per epoch in the retiring participant and are reused once the global epoch
+ * has advanced twice, which only happens after every pinned participant has observed the newer epoch.
+ * Participants cache chunks locally, so allocating, retiring and reusing a chunk only locks the shared pool once per batch.
+ *
+ * Retired objects are not destroyed, they must be trivially destructible or destroyed by the caller before they are retired.
+ *
+ * @class
+ */
+class EpochPoolAllocator {
+
+    // Number of chunks moved between the shared pool and a participant at once, and number of retires between two reclaims
+    static constexpr size_t BatchSize = 64;
+
+    // Retired chunks of a participant that left while the chunks were still in use
+    struct OrphanBatch {
+
+        uint64_t epoch;
+        std::vector<void*> chunks;
+    };
+
+public:
+
+    class Participant;
+    class Guard;
+
+    EpochPoolAllocator() = delete;
+
+    /* @brief Constructor that creates the shared pool.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes.
+     * @param chunkSize    The size of each allocatable memory region.
+     * @param parent    Optional parent allocator to get memory from.
+     */
+    explicit EpochPoolAllocator(const size_t totalMemory, const size_t chunkSize, IAllocator *parent = nullptr);
+
+    /* @brief Destructor, all participants must have been destroyed before.
+     */
+    ~EpochPoolAllocator();
+
+    EpochPoolAllocator(const EpochPoolAllocator&) = delete;
+    EpochPoolAllocator& operator=(const EpochPoolAllocator&) = delete;
+
+    uint64_t    epoch()         const { return mEpoch.load(std::memory_order_acquire);}
+    size_t      chunkSize()     const { return mChunkSize;}
+    size_t      totalMemory()   const { return mPool.totalMemory();}
+
+    /* @brief Returns the memory taken from the shared pool, including chunks cached or retired by participants.
+     */
+    size_t usedMemory();
+
+
+private:
+
+    /* @brief Advances the global epoch if all pinned participants have observed the current epoch.
+     *
+     * @return The global epoch after the attempt.
+     */
+    uint64_t TryAdvance();
+
+    /* @brief Moves up to count chunks from the shared pool to the end of chunks.
+     *
+     * @param chunks    The vector to fill.
+     * @param count    Maximum number of chunks to move.
+     */
+    void TakeChunks(std::vector<void*> &chunks, const size_t count);
+
+    /* @brief Returns the last count chunks of the vector to the shared pool and removes them from the vector.
+     *
+     * @param chunks    The vector to take the chunks from.
+     * @param count    Number of chunks to return.
+     */
+    void ReturnChunks(std::vector<void*> &chunks, const size_t count);
+
+
+    PoolAllocator mPool;
+    size_t mChunkSize;
+    // Protects mPool, mParticipants and mOrphans
+    std::mutex mMutex;
+
+    std::atomic<uint64_t> mEpoch;
+    std::vector<Participant*> mParticipants;
+    std::vector<OrphanBatch> mOrphans;
+};
+
+
+/* @brief Per-thread access to an EpochPoolAllocator, must only be used by one thread at a time.
+ *
+ * @class
+ */
+class EpochPoolAllocator::Participant {
+
+public:
+
+    Participant() = delete;
+
+    /* @brief Constructor that registers the participant with the allocator.
+     *
+     * @param allocator    The allocator to take chunks from.
+     */
+    explicit Participant(EpochPoolAllocator &allocator);
+
+    /* @brief Destructor that returns cached chunks and hands retired chunks over to the allocator. The participant must not be pinned.
+     */
+    ~Participant();
+
+    Participant(const Participant&) = delete;
+    Participant& operator=(const Participant&) = delete;
+
+    /* @brief Announces that the calling thread may now read shared nodes, chunks retired from now on are not reused before Unpin(). Pins nest.
+     */
+    void Pin();
+
+    /* @brief Ends the read section started by the matching Pin().
+     */
+    void Unpin();
+
+    /* @brief Allocates a chunk from the local cache, refilled from the shared pool or reclaimed chunks when empty.
+     *
+     * return Pointer to the allocated chunk.
+     */
+    void* Allocate();
+
+    /* @brief Defers freeing a chunk that was unlinked from a shared data structure until no pinned participant can still read it.
+     *
+     * @param ptr    Pointer to the chunk to retire.
+     */
+    void  Retire(void* ptr);
+
+    /* @brief Frees a chunk right away, only for chunks that were never visible to other threads.
+     *
+     * @param ptr    Pointer to the chunk to free.
+     */
+    void  Free(void* ptr);
+
+    /* @brief Tries to advance the global epoch and moves all retired chunks that are safe to reuse into the local cache.
+     */
+    void  Reclaim();
+
+    bool    pinned()        const { return mPinDepth > 0;}
+    size_t  retiredChunks() const;
+
+
+private:
+
+    friend class EpochPoolAllocator;
+
+    /* @brief Moves the retired chunks of all batches from epochs at least two before the given epoch into the local cache.
+     *
+     * @param epoch    The current global epoch.
+     */
+    void ReclaimBatches(const uint64_t epoch);
+
+    /* @brief Returns cached chunks above the cache limit to the shared pool.
+     */
+    void TrimCache();
+
+
+    EpochPoolAllocator &mAllocator;
+
+    // Epoch observed by Pin() shifted left by one, with the lowest bit set while pinned
+    std::atomic<uint64_t> mLocalEpoch;
+    size_t mPinDepth;
+
+    std::vector<void*> mCache;
+    // Retired chunks, batch i holds chunks retired in the last epoch e with e % 3 == i
+    std::vector<void*> mRetired[3];
+    uint64_t mRetiredEpoch[3];
+    size_t mRetiresSinceReclaim;
+};
+
+
+/* @brief Pins a participant for the lifetime of the guard.
+ *
+ * @class
+ */
+class EpochPoolAllocator::Guard {
+
+public:
+
+    explicit Guard(Participant &participant) : mParticipant {participant} { mParticipant.Pin();}
+    ~Guard() { mParticipant.Unpin();}
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+
+private:
+
+    Participant &mParticipant;
+};
@@ -1,29 +1,60 @@
 
 #include "free_list_allocator.h"
+#include "virtual_memory.h"
+#include <type_traits>
 
 
-FreeListAllocator::FreeListAllocator(const size_t totalMemory, IAllocator *parent) :
-    IAllocator(totalMemory, parent)
+template<typename Policy>
+BasicFreeListAllocator<Policy>::BasicFreeListAllocator(const size_t totalMemory, IAllocator *parent) :
+    IAllocator(totalMemory, parent),
+    mMaxFastSize {0},
+    mDecayTime {0},
+    mLastTrim {std::chrono::steady_clock::now()}
 {
+    mZeroedAddress = reinterpret_cast<uintptr_t>(pBase) + (mZeroedMemory ? 0 : mTotalMemory);
     Clear();
 }
 
-FreeListAllocator::~FreeListAllocator() {
+template<typename Policy>
+BasicFreeListAllocator<Policy>::~BasicFreeListAllocator() {
 
 }
 
-void* FreeListAllocator::Allocate(const size_t size, const size_t align) {
+template<typename Policy>
+void* BasicFreeListAllocator<Policy>::Allocate(const size_t size, const size_t align) {
     
-    // Pad size so that total allocated space can fit a TreeNode when freed
+    // Pad size so that total allocated space can fit a FreeNode when freed
     size_t paddedSize = std::max(size, sizeof(FreeNode) - sizeof(AllocHeader));
 
-    // Find memory region large enough for allocation
+    // Small sizes are rounded up to the fast bin step, so the sizes of freed and requested blocks match exactly
+    if (paddedSize <= mMaxFastSize)
+    {
+        paddedSize = (std::max(paddedSize, FastBinStep) + FastBinStep - 1) / FastBinStep * FastBinStep;
+
+        offset_t &bin = mFastBins[paddedSize / FastBinStep];
+        if (bin != NullOffset && getAlignmentAdjustment(reinterpret_cast<uintptr_t>(pBase) + bin, align) == 0)
+        {
+            // Reuse the most recently freed block, its AllocHeader is still intact
+            void *mem = FromOffset<void>(bin);
+            bin = *static_cast<offset_t*>(mem);
+            --mNumFastBinned;
+
+            AllocHeader *header = reinterpret_cast<AllocHeader*>(reinterpret_cast<uintptr_t>(mem) - sizeof(AllocHeader));
+            mUsedMemory += header->adjustment + sizeof(AllocHeader) + header->size;
+            mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+            return mem;
+        }
+    }
+
+    // Find memory region large enough for allocation, consolidate the fast bins once if there is none
     size_t requiredSize = paddedSize + sizeof(AllocHeader) + align - 1;
-    FreeNode *currNode = pHead, *prevNode = nullptr;
-    while (currNode && currNode->size < requiredSize)
+    FreeNode *prevNode = nullptr;
+    FreeNode *currNode = FindNode(requiredSize, prevNode);
+    if (currNode == nullptr && mNumFastBinned > 0)
     {
-        prevNode = currNode;
-        currNode = currNode->next;
+        Consolidate();
+        currNode = FindNode(requiredSize, prevNode);
     }
 
     if (currNode == nullptr)
@@ -32,12 +63,13 @@ void* FreeListAllocator::Allocate(const size_t size, const size_t align) {
     }
 
     // Find properly aligned address for allocation
-    size_t adjustment = getAlignmentAdjustment(currNode->address + sizeof(AllocHeader), align);
-    uintptr_t alignedAddress = currNode->address + adjustment + sizeof(AllocHeader);
+    uintptr_t nodeAddress = reinterpret_cast<uintptr_t>(currNode);
+    size_t adjustment = getAlignmentAdjustment(nodeAddress + sizeof(AllocHeader), align);
+    uintptr_t alignedAddress = nodeAddress + adjustment + sizeof(AllocHeader);
 
     // Create a new node from remaining memory region of current node. 
     // If remaining memory is smaller than a FreeNode add it to the allocated memory section instead
-    size_t newSize = currNode->address + currNode->size - alignedAddress - paddedSize;
+    size_t newSize = nodeAddress + currNode->size - alignedAddress - paddedSize;
     size_t allocSize = paddedSize;
     FreeNode *newNode = nullptr;
     if(newSize >= sizeof(FreeNode))
@@ -47,7 +79,7 @@ void* FreeListAllocator::Allocate(const size_t size, const size_t align) {
     else
     {
         allocSize += newSize;
-        newNode = currNode->next;
+        newNode = Node(currNode->next);
     }
 
     if (prevNode == nullptr)
@@ -56,8 +88,9 @@ void* FreeListAllocator::Allocate(const size_t size, const size_t align) {
     }
     else
     {
-        prevNode->next = newNode;
+        prevNode->next = ToOffset(newNode);
     }
+    pRover = prevNode;
 
     // Place allocation header in front of allocated memory section
     AllocHeader *header = reinterpret_cast<AllocHeader*>(alignedAddress - sizeof(AllocHeader));
@@ -67,10 +100,29 @@ void* FreeListAllocator::Allocate(const size_t size, const size_t align) {
     mUsedMemory += header->adjustment + sizeof(AllocHeader) + header->size;
     mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
 
+    // The allocated section and the new FreeNode behind it may be written to from now on
+    RaiseZeroedAddress(alignedAddress + allocSize + sizeof(FreeNode));
+
     return reinterpret_cast<void*>(alignedAddress);
 }
 
-void FreeListAllocator::Free(void* ptr) {
+template<typename Policy>
+void* BasicFreeListAllocator<Policy>::AllocateZeroed(const size_t size, const size_t align) {
+
+    uintptr_t zeroedAddress = mZeroedAddress;
+    void *mem = Allocate(size, align);
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(mem);
+    if (address < zeroedAddress)
+    {
+        ZeroMemory(mem, std::min(size, zeroedAddress - address));
+    }
+
+    return mem;
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::Free(void* ptr) {
 
     assert(ptr != nullptr);
 
@@ -82,42 +134,333 @@ void FreeListAllocator::Free(void* ptr) {
 
     mUsedMemory -= freeSize;
 
+    // Small blocks go to their fast bin without coalescing, the link to the next block is stored in the freed memory
+    if (header->size >= FastBinStep && header->size <= mMaxFastSize)
+    {
+        offset_t &bin = mFastBins[header->size / FastBinStep];
+        *static_cast<offset_t*>(ptr) = bin;
+        bin = ToOffset(ptr);
+        ++mNumFastBinned;
+    }
+    else
+    {
+        InsertFreeRegion(freeAddress, freeSize);
+    }
+
+    Decay();
+}
+
+template<typename Policy>
+size_t BasicFreeListAllocator<Policy>::AllocatedSize(const void* ptr) const {
+
+    const AllocHeader *header = reinterpret_cast<const AllocHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocHeader));
+
+    return header->size;
+}
+
+template<typename Policy>
+bool BasicFreeListAllocator<Policy>::TryExpand(void* ptr, const size_t newSize) {
+
+    assert(ptr != nullptr);
+
+    AllocHeader *header = reinterpret_cast<AllocHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocHeader));
+    if (newSize <= header->size)
+    {
+        return true;
+    }
+
+    // find free node directly behind the allocated memory section
+    uintptr_t endAddress = reinterpret_cast<uintptr_t>(ptr) + header->size;
+    FreeNode *currNode = pHead, *prevNode = nullptr;
+    while (currNode && reinterpret_cast<uintptr_t>(currNode) < endAddress)
+    {
+        prevNode = currNode;
+        currNode = Node(currNode->next);
+    }
+
+    size_t growSize = newSize - header->size;
+    if (!currNode || reinterpret_cast<uintptr_t>(currNode) != endAddress || currNode->size < growSize)
+    {
+        return false;
+    }
+
+    // Move the node behind the grown section, this may override the current node, so read it first.
+    // If the remaining memory is smaller than a FreeNode add it to the allocated memory section instead
+    size_t remainingSize = currNode->size - growSize;
+    FreeNode *nextNode = Node(currNode->next);
+    if (remainingSize >= sizeof(FreeNode))
+    {
+        nextNode = new (reinterpret_cast<void*>(endAddress + growSize)) FreeNode(remainingSize, ToOffset(nextNode));
+    }
+    else
+    {
+        growSize += remainingSize;
+    }
+
+    if (prevNode == nullptr)
+    {
+        pHead = nextNode;
+    }
+    else
+    {
+        prevNode->next = ToOffset(nextNode);
+    }
+    if (pRover == currNode)
+    {
+        pRover = prevNode;
+    }
+
+    header->size += growSize;
+
+    mUsedMemory += growSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    RaiseZeroedAddress(endAddress + growSize + sizeof(FreeNode));
+
+    return true;
+}
+
+template<typename Policy>
+size_t BasicFreeListAllocator<Policy>::Trim(const bool lazy) {
+
+    Consolidate();
+
+    size_t trimmedSize = 0;
+    for (FreeNode *node = pHead; node; node = Node(node->next))
+    {
+        uintptr_t nodeAddress = reinterpret_cast<uintptr_t>(node);
+        trimmedSize += VirtualMemory::DiscardPages(nodeAddress + sizeof(FreeNode), nodeAddress + node->size, lazy);
+    }
+
+    mLastTrim = std::chrono::steady_clock::now();
+
+    return trimmedSize;
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::SetFastBins(const size_t maxFastSize) {
+
+    assert(maxFastSize <= MaxFastBinSize);
+
+    Consolidate();
+    mMaxFastSize = maxFastSize;
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::Consolidate() {
+
+    for (offset_t &bin : mFastBins)
+    {
+        while (bin != NullOffset)
+        {
+            uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + bin;
+            bin = *FromOffset<offset_t>(bin);
+
+            AllocHeader *header = reinterpret_cast<AllocHeader*>(address - sizeof(AllocHeader));
+            InsertFreeRegion(address - header->adjustment - sizeof(AllocHeader), header->adjustment + sizeof(AllocHeader) + header->size);
+        }
+    }
+
+    mNumFastBinned = 0;
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::SetDecayTime(const std::chrono::milliseconds decayTime) {
+
+    mDecayTime = decayTime;
+}
+
+template<typename Policy>
+size_t BasicFreeListAllocator<Policy>::residentMemory() const {
+
+    return VirtualMemory::ResidentBytes(pBase, mTotalMemory);
+}
+
+template<typename Policy>
+size_t BasicFreeListAllocator<Policy>::freeBlocks() const {
+
+    size_t count = 0;
+    for (FreeNode *node = pHead; node; node = Node(node->next))
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+template<typename Policy>
+size_t BasicFreeListAllocator<Policy>::largestFreeBlock() const {
+
+    size_t largest = 0;
+    for (FreeNode *node = pHead; node; node = Node(node->next))
+    {
+        largest = std::max(largest, static_cast<size_t>(node->size));
+    }
+
+    return largest;
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::Decay() {
+
+    if (mDecayTime.count() > 0 && std::chrono::steady_clock::now() - mLastTrim >= mDecayTime)
+    {
+        Trim();
+    }
+}
+
+template<typename Policy>
+typename BasicFreeListAllocator<Policy>::FreeNode* BasicFreeListAllocator<Policy>::FindNode(const size_t size, FreeNode *&prevNode) const {
+
+    FreeNode *currNode = pHead;
+    prevNode = nullptr;
+
+    if constexpr (std::is_same_v<Policy, Placement::FirstFit>)
+    {
+        while (currNode && currNode->size < size)
+        {
+            prevNode = currNode;
+            currNode = Node(currNode->next);
+        }
+
+        return currNode;
+    }
+    else if constexpr (std::is_same_v<Policy, Placement::NextFit>)
+    {
+        // Search from the rover to the end of the list, then from pHead up to the rover
+        FreeNode *startNode = pRover ? Node(pRover->next) : pHead;
+        prevNode = pRover;
+        currNode = startNode;
+        while (currNode && currNode->size < size)
+        {
+            prevNode = currNode;
+            currNode = Node(currNode->next);
+        }
+
+        if (currNode == nullptr && startNode != pHead)
+        {
+            prevNode = nullptr;
+            currNode = pHead;
+            while (currNode != startNode && currNode->size < size)
+            {
+                prevNode = currNode;
+                currNode = Node(currNode->next);
+            }
+
+            if (currNode == startNode)
+            {
+                currNode = nullptr;
+            }
+        }
+
+        return currNode;
+    }
+    else
+    {
+        static_assert(std::is_same_v<Policy, Placement::BestFit> || std::is_same_v<Policy, Placement::WorstFit>, "Unknown placement policy.");
+
+        // Visit every node and keep the smallest or largest one that is large enough
+        FreeNode *bestNode = nullptr, *bestPrevNode = nullptr;
+        for (; currNode; prevNode = currNode, currNode = Node(currNode->next))
+        {
+            if (currNode->size < size)
+            {
+                continue;
+            }
+
+            bool better = bestNode == nullptr;
+            if constexpr (std::is_same_v<Policy, Placement::BestFit>)
+            {
+                better = better || currNode->size < bestNode->size;
+            }
+            else
+            {
+                better = better || currNode->size > bestNode->size;
+            }
+
+            if (better)
+            {
+                bestNode = currNode;
+                bestPrevNode = prevNode;
+
+                // An exact fit can not be beaten
+                if (std::is_same_v<Policy, Placement::BestFit> && currNode->size == size)
+                {
+                    break;
+                }
+            }
+        }
+
+        prevNode = bestPrevNode;
+        return bestNode;
+    }
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::InsertFreeRegion(const uintptr_t address, const size_t size) {
+
+    uintptr_t freeAddress = address;
+    size_t freeSize = size;
+
     // find adjacent nodes
     FreeNode *nextNode = pHead, *prevNode = nullptr;
-    while (nextNode && nextNode->address < freeAddress)
+    while (nextNode && reinterpret_cast<uintptr_t>(nextNode) < freeAddress)
     {
         prevNode = nextNode;
-        nextNode = nextNode->next;
+        nextNode = Node(nextNode->next);
     }
 
     // combine freed memory section with adjacent nodes if necessary
-    if (prevNode && prevNode->address + prevNode->size == freeAddress)
+    if (prevNode && reinterpret_cast<uintptr_t>(prevNode) + prevNode->size == freeAddress)
     {
-        freeAddress = prevNode->address;
+        freeAddress = reinterpret_cast<uintptr_t>(prevNode);
         freeSize += prevNode->size;
     }
-    if (nextNode && nextNode->address == freeAddress + freeSize)
+    bool absorbedRover = false;
+    if (nextNode && reinterpret_cast<uintptr_t>(nextNode) == freeAddress + freeSize)
     {
+        absorbedRover = nextNode == pRover;
         freeSize += nextNode->size;
-        nextNode = nextNode->next;
+        nextNode = Node(nextNode->next);
     }
     
     // create new node for freed section, this may override prevNode, but all pointers are still valid 
-    FreeNode *newNode = new (reinterpret_cast<void*>(freeAddress)) FreeNode(freeSize, nextNode);
+    FreeNode *newNode = new (reinterpret_cast<void*>(freeAddress)) FreeNode(freeSize, ToOffset(nextNode));
+    if (absorbedRover)
+    {
+        pRover = newNode;
+    }
     
     if (prevNode == nullptr)
     {
         pHead = newNode;
-        return;
     }
-    if (prevNode != newNode)
+    else if (prevNode != newNode)
     {
-        prevNode->next = newNode;
+        prevNode->next = ToOffset(newNode);
     }
 }
 
-void FreeListAllocator::Clear() {
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::RaiseZeroedAddress(const uintptr_t address) {
+
+    mZeroedAddress = std::max(mZeroedAddress, std::min(address, reinterpret_cast<uintptr_t>(pBase) + mTotalMemory));
+}
+
+template<typename Policy>
+void BasicFreeListAllocator<Policy>::Clear() {
     
     pHead = new (pBase) FreeNode(mTotalMemory);
+    pRover = nullptr;
+    std::fill(std::begin(mFastBins), std::end(mFastBins), NullOffset);
+    mNumFastBinned = 0;
     mUsedMemory = 0;
-}
\ No newline at end of file
+
+    RaiseZeroedAddress(reinterpret_cast<uintptr_t>(pBase) + sizeof(FreeNode));
+}
+
+
+template class BasicFreeListAllocator<Placement::FirstFit>;
+template class BasicFreeListAllocator<Placement::NextFit>;
+template class BasicFreeListAllocator<Placement::BestFit>;
+template class BasicFreeListAllocator<Placement::WorstFit>;
\ No newline at end of file
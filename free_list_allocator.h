@@ -3,55 +3,76 @@
 
 #include "allocator.h"
 
+#include <chrono>
+
+
+/* Placement policies of BasicFreeListAllocator, selecting the free region an allocation is taken from.
+ */
+namespace Placement {
+
+    // First region in address order that is large enough
+    struct FirstFit {};
+    // First region large enough, searching on from where the previous allocation was placed and wrapping around
+    struct NextFit {};
+    // Smallest region large enough
+    struct BestFit {};
+    // Largest region
+    struct WorstFit {};
+}
+
 
 /* @brief Free list implementation of IAllocator.
  * 
- * Keeps track of unallocated memory regions with a list of FreeNodes, holding the size and address of the free region.
- * Allocates new memory from the first FreeNode large enough.
+ * Keeps track of unallocated memory regions with an address ordered list of FreeNodes placed at the start of each free region, holding the size of the region.
+ * Sizes and links are stored as offset_t offsets from pBase, see ALLOCATOR_COMPACT_METADATA.
+ * Allocates new memory from the FreeNode selected by the placement policy, one of the types in the Placement namespace.
  * Frees memory by creating a new FreeNode in place of the allocated memory section or merges it with direct neighbors.
  * Clears all allocations by creating a new pHead FreeNode holding all the managed memory.
+ * With SetFastBins() small blocks are freed to exact-size LIFO bins instead and reused in O(1), they are only coalesced by Consolidate().
  * 
  * @class 
  */
-class FreeListAllocator : public IAllocator{
+template<typename Policy>
+class BasicFreeListAllocator : public IAllocator{
 
     struct FreeNode {
 
-        size_t size;
-        uintptr_t address;
-        FreeNode *next;
-
-        FreeNode() : size {0}, address {0UL}, next {nullptr} {}
-        FreeNode(const size_t size_, FreeNode *next_ = nullptr) : size {size_}, next {next_} {
+        // Size and link to the next node are stored as offsets from pBase
+        offset_t size;
+        offset_t next;
 
-            address = reinterpret_cast<uintptr_t>(this);
-        }
+        FreeNode() : size {0}, next {NullOffset} {}
+        FreeNode(const size_t size_, const offset_t next_ = NullOffset) : size {static_cast<offset_t>(size_)}, next {next_} {}
     };
 
     struct AllocHeader {
 
-        size_t size;
-        size_t adjustment;
+        offset_t size;
+        offset_t adjustment;
 
-        AllocHeader(const size_t size_, const size_t adjustment_) : size {size_}, adjustment {adjustment} {}
+        AllocHeader(const size_t size_, const size_t adjustment_) : size {static_cast<offset_t>(size_)}, adjustment {static_cast<offset_t>(adjustment_)} {}
     };
 
+    // Fast bin i holds freed blocks with a usable size in [i * FastBinStep, (i + 1) * FastBinStep)
+    static constexpr size_t FastBinStep = 16;
+    static constexpr size_t MaxFastBinSize = 1024;
+
 public:
 
-    FreeListAllocator() = delete;
+    BasicFreeListAllocator() = delete;
 
     /* @brief Constructor that allocates the managed memory portion and calls Clear() method to reset free list.
      *
      * @param totalMemory    The size of the managed memory space in bytes.
      * @param parent    Optional parent allocator to get memory from.
      */
-    explicit FreeListAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
+    explicit BasicFreeListAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
 
     /* @brief Default destructor that does nothing.
      */
-    ~FreeListAllocator();
+    ~BasicFreeListAllocator();
     
-    /* @brief Allocates a properly aligned section of memory from the first FreeNode large enough. 
+    /* @brief Allocates a properly aligned section of memory from the FreeNode selected by the placement policy. 
      *  
      * @param size    The size of the allocated memory section.
      * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
@@ -60,6 +81,15 @@ public:
      */
     void* Allocate(const size_t size, const size_t align = 1) override;
 
+    /* @brief Allocates a zero filled memory section, clearing only the part below the highest address ever written to.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
     /* @brief Frees the allocated memory section at ptr and creates a new FreeNode at that position or merges the new node with direct neighbors.
      * 
      * @param ptr    Pointer to the memory position to free.
@@ -70,8 +100,113 @@ public:
      */
     void  Clear() override;
 
+    /* @brief Returns the usable size of an allocated memory section stored in its AllocHeader.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Grows an allocated memory section in place by absorbing the free region directly behind it.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * @param newSize    The requested new size in bytes.
+     * 
+     * @return True if the memory section at ptr now holds at least newSize bytes.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Gives the pages inside all free regions back to the operating system, keeping the FreeNode at the start of each region intact.
+     *
+     * @param lazy    Let the operating system reclaim the pages only under memory pressure (MADV_FREE).
+     * 
+     * @return The number of bytes given back.
+     */
+    size_t Trim(const bool lazy = false);
+
+    /* @brief Lets Free() put blocks of up to maxFastSize usable bytes into fast bins without coalescing, and Allocate() reuse them in O(1).
+     * Binned blocks are consolidated when an allocation finds no large enough region, on Trim() and on Consolidate().
+     *
+     * @param maxFastSize    Largest usable size of binned blocks, at most MaxFastBinSize, zero disables the fast bins.
+     */
+    void  SetFastBins(const size_t maxFastSize);
+
+    /* @brief Empties the fast bins and coalesces their blocks with neighboring free regions.
+     */
+    void  Consolidate();
+
+    /* @brief Lets Free() call Trim() once the decay time has passed since the last trim.
+     *
+     * @param decayTime    Minimum time between two trims, zero disables trimming from Free().
+     */
+    void  SetDecayTime(const std::chrono::milliseconds decayTime);
+
+    /* @brief Returns the number of bytes of the managed memory that are resident in physical memory.
+     */
+    size_t residentMemory() const;
+
+    /* @brief Returns the number of free regions, walks the whole free list. Blocks in fast bins are not counted.
+     */
+    size_t freeBlocks() const;
+
+    /* @brief Returns the size in bytes of the largest free region, walks the whole free list. Blocks in fast bins are not counted.
+     */
+    size_t largestFreeBlock() const;
+
 
 private:
 
+    /* @brief Calls Trim() if decay is enabled and the decay time has passed since the last trim.
+     */
+    void Decay();
+
+    /* @brief Searches the free list for a region of at least size bytes according to the placement policy.
+     *
+     * @param size    Required size of the free memory region in bytes.
+     * @param prevNode    Set to the node in front of the found node, nullptr if it is pHead.
+     *
+     * @return Pointer to the FreeNode representing the memory region, nullptr if there is none.
+     */
+    FreeNode* FindNode(const size_t size, FreeNode *&prevNode) const;
+
+    /* @brief Inserts a free region into the address ordered list, merging it with its direct neighbors.
+     *
+     * @param address    Start address of the free region.
+     * @param size    Size of the free region in bytes.
+     */
+    void InsertFreeRegion(const uintptr_t address, const size_t size);
+
+    /* @brief Raises mZeroedAddress to address, clipped to the end of the managed memory.
+     *
+     * @param address    End of a memory section that may be written to from now on.
+     */
+    void RaiseZeroedAddress(const uintptr_t address);
+
+    /* @brief Converts the offset of a node to a pointer.
+     *
+     * @param offset    Offset of the node from pBase or NullOffset.
+     */
+    FreeNode* Node(const offset_t offset) const { return FromOffset<FreeNode>(offset);}
+
+
     FreeNode* pHead;
-};
\ No newline at end of file
+    // Next fit searches on behind this node, nullptr to start at pHead
+    FreeNode* pRover;
+    // All memory from this address on is known to be zero
+    uintptr_t mZeroedAddress;
+
+    // Heads of the fast bins, linked through the first offset_t of each freed block
+    offset_t mFastBins[MaxFastBinSize / FastBinStep + 1];
+    size_t mNumFastBinned;
+    size_t mMaxFastSize;
+
+    std::chrono::milliseconds mDecayTime;
+    std::chrono::steady_clock::time_point mLastTrim;
+};
+
+
+using FreeListAllocator = BasicFreeListAllocator<Placement::FirstFit>;
+
+extern template class BasicFreeListAllocator<Placement::FirstFit>;
+extern template class BasicFreeListAllocator<Placement::NextFit>;
+extern template class BasicFreeListAllocator<Placement::BestFit>;
+extern template class BasicFreeListAllocator<Placement::WorstFit>;
@@ -1,28 +1,100 @@
 
 #include "free_tree_allocator.h"
+#include "virtual_memory.h"
 #include <stdexcept>
+#include <functional>
 #include <iostream>
 
 
 FreeTreeAllocator::FreeTreeAllocator(const size_t totalMemory, IAllocator *parent) :
     IAllocator(totalMemory, parent),
-    pRoot {nullptr}
+    pRoot {nullptr},
+    mMaxPending {0},
+    pMappings {nullptr},
+    mDirectMapAllowed {true},
+    mDirectMapThreshold {0},
+    mDirectMappedMemory {0},
+    mDecayTime {0},
+    mLastTrim {std::chrono::steady_clock::now()}
 {
+    mZeroedAddress = reinterpret_cast<uintptr_t>(pBase) + (mZeroedMemory ? 0 : mTotalMemory);
     Clear();
 }
 
+FreeTreeAllocator::FreeTreeAllocator(void *base, const size_t totalMemory) :
+    IAllocator(base, totalMemory),
+    pRoot {nullptr},
+    mZeroedAddress {reinterpret_cast<uintptr_t>(base) + totalMemory},
+    mMaxPending {0},
+    pMappings {nullptr},
+    mDirectMapAllowed {false},
+    mDirectMapThreshold {0},
+    mDirectMappedMemory {0},
+    mDecayTime {0},
+    mLastTrim {std::chrono::steady_clock::now()}
+{
+}
+
 FreeTreeAllocator::~FreeTreeAllocator() {
 
+    while (pMappings)
+    {
+        FreeDirect(pMappings);
+    }
+}
+
+template<typename Func>
+void FreeTreeAllocator::ForEachNode(Func func) const {
+
+    TreeNode *node = pRoot;
+    while (node && node->left != NullOffset)
+    {
+        node = Node(node->left);
+    }
+
+    while (node)
+    {
+        func(node);
+
+        if (node->right != NullOffset)
+        {
+            node = Node(node->right);
+            while (node->left != NullOffset)
+            {
+                node = Node(node->left);
+            }
+        }
+        else
+        {
+            TreeNode *child = node;
+            node = Node(node->parent);
+            while (node && child == Node(node->right))
+            {
+                child = node;
+                node = Node(node->parent);
+            }
+        }
+    }
 }
 
 void* FreeTreeAllocator::Allocate(const size_t size, const size_t align) {
 
+    if (mDirectMapThreshold > 0 && size >= mDirectMapThreshold)
+    {
+        return AllocateDirect(size, align);
+    }
+
     // Pad size so that total allocated space can fit a TreeNode when freed
-    size_t paddedSize = std::max(size, sizeof(TreeNode) - sizeof(AllocHeader));
+    size_t paddedSize = std::max(size, MinAllocationSize);
 
     // Find best memory region to allocate from
     size_t requiredSize = paddedSize + sizeof(AllocHeader) + align - 1;    
     TreeNode *allocNode = FindNode(requiredSize, pRoot);
+    if (allocNode == nullptr && !mPending.empty())
+    {
+        FlushPending();
+        allocNode = FindNode(requiredSize, pRoot);
+    }
     if (allocNode == nullptr)
     {
         throw std::overflow_error("Free tree allocator does not have a large enough memory region available.");
@@ -55,13 +127,37 @@ void* FreeTreeAllocator::Allocate(const size_t size, const size_t align) {
     mUsedMemory += header->adjustment + sizeof(AllocHeader) + header->size;
     mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
 
+    // The allocated section and the new TreeNode behind it may be written to from now on
+    RaiseZeroedAddress(alignedAddress + allocSize + sizeof(TreeNode));
+
     return reinterpret_cast<void*>(alignedAddress);
 }
 
+void* FreeTreeAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    uintptr_t zeroedAddress = mZeroedAddress;
+    void *mem = Allocate(size, align);
+
+    // Direct mapped allocations come as fresh pages
+    uintptr_t address = reinterpret_cast<uintptr_t>(mem);
+    if (IAllocator::Owns(mem) && address < zeroedAddress)
+    {
+        ZeroMemory(mem, std::min(size, zeroedAddress - address));
+    }
+
+    return mem;
+}
+
 void FreeTreeAllocator::Free(void* ptr) {
 
     assert(ptr != nullptr);
 
+    if (!IAllocator::Owns(ptr))
+    {
+        FreeDirect(DirectHeader(ptr));
+        return;
+    }
+
     // start address and size of freed memory section
     uintptr_t freeAddress = reinterpret_cast<uintptr_t>(ptr);
     AllocHeader *header = reinterpret_cast<AllocHeader*>( freeAddress - sizeof(AllocHeader) );
@@ -70,7 +166,269 @@ void FreeTreeAllocator::Free(void* ptr) {
 
     mUsedMemory -= freeSize;
     
-    TreeNode *newNode = new (reinterpret_cast<void*>(freeAddress)) TreeNode(freeSize);
+    if (mMaxPending > 0)
+    {
+        // Defer coalescing, the TreeNode only records the size until the block is inserted into the tree
+        mPending.push_back(new (reinterpret_cast<void*>(freeAddress)) TreeNode(freeSize));
+        if (mPending.size() >= mMaxPending)
+        {
+            FlushPending();
+        }
+    }
+    else
+    {
+        InsertFreeRegion(freeAddress, freeSize);
+    }
+
+    Decay();
+}
+
+void FreeTreeAllocator::Clear() {
+    
+    pRoot = new (pBase) TreeNode(mTotalMemory);
+    mPending.clear();
+    mUsedMemory = 0;
+
+    while (pMappings)
+    {
+        FreeDirect(pMappings);
+    }
+
+    RaiseZeroedAddress(reinterpret_cast<uintptr_t>(pBase) + sizeof(TreeNode));
+}
+
+size_t FreeTreeAllocator::AllocatedSize(const void* ptr) const {
+
+    if (!IAllocator::Owns(ptr))
+    {
+        return DirectHeader(ptr)->mapSize - DirectHeader(ptr)->offset;
+    }
+
+    const AllocHeader *header = reinterpret_cast<const AllocHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocHeader));
+
+    return header->size;
+}
+
+bool FreeTreeAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    assert(ptr != nullptr);
+
+    // Direct mapped allocations can only grow into the rest of their last page
+    if (!IAllocator::Owns(ptr))
+    {
+        return newSize <= AllocatedSize(ptr);
+    }
+
+    AllocHeader *header = reinterpret_cast<AllocHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(AllocHeader));
+    if (newSize <= header->size)
+    {
+        return true;
+    }
+
+    // find free node directly behind the allocated memory section
+    uintptr_t endAddress = reinterpret_cast<uintptr_t>(ptr) + header->size;
+    TreeNode *node = pRoot;
+    while (node && reinterpret_cast<uintptr_t>(node) != endAddress)
+    {
+        node = Node(endAddress < reinterpret_cast<uintptr_t>(node) ? node->left : node->right);
+    }
+
+    size_t growSize = newSize - header->size;
+    if (!node || node->size < growSize)
+    {
+        return false;
+    }
+
+    // Move the node behind the grown section if the remaining memory can fit a TreeNode.
+    // If not add the whole free region to the allocated memory section
+    size_t remainingSize = node->size - growSize;
+    if (remainingSize >= sizeof(TreeNode))
+    {
+        MoveNode(node, reinterpret_cast<void*>(endAddress + growSize), remainingSize);
+    }
+    else
+    {
+        growSize += remainingSize;
+        RemoveNode(node);
+    }
+
+    header->size += growSize;
+
+    mUsedMemory += growSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    RaiseZeroedAddress(endAddress + growSize + sizeof(TreeNode));
+
+    return true;
+}
+
+bool FreeTreeAllocator::Owns(const void* ptr) const {
+
+    if (IAllocator::Owns(ptr))
+    {
+        return true;
+    }
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    for (MapHeader *header = pMappings; header; header = header->next)
+    {
+        uintptr_t mapAddress = reinterpret_cast<uintptr_t>(header) + sizeof(MapHeader) - header->offset;
+        if (address >= mapAddress && address < mapAddress + header->mapSize)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t FreeTreeAllocator::Trim(const bool lazy) {
+
+    FlushPending();
+
+    size_t trimmedSize = 0;
+    ForEachNode([&](TreeNode *node) {
+
+        uintptr_t nodeAddress = reinterpret_cast<uintptr_t>(node);
+        trimmedSize += VirtualMemory::DiscardPages(nodeAddress + sizeof(TreeNode), nodeAddress + node->size, lazy);
+    });
+
+    mLastTrim = std::chrono::steady_clock::now();
+
+    return trimmedSize;
+}
+
+void FreeTreeAllocator::SetMaxPending(const size_t maxPending) {
+
+    mMaxPending = maxPending;
+    if (mPending.size() >= mMaxPending)
+    {
+        FlushPending();
+    }
+    mPending.reserve(mMaxPending);
+}
+
+void FreeTreeAllocator::FlushPending() {
+
+    // Sorting by address lets neighboring pending blocks merge before they are inserted into the tree
+    std::sort(mPending.begin(), mPending.end());
+
+    for (size_t i = 0; i < mPending.size(); i++)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(mPending[i]);
+        size_t size = mPending[i]->size;
+        while (i + 1 < mPending.size() && address + size == reinterpret_cast<uintptr_t>(mPending[i + 1]))
+        {
+            size += mPending[++i]->size;
+        }
+
+        InsertFreeRegion(address, size);
+    }
+
+    mPending.clear();
+}
+
+void FreeTreeAllocator::SetDirectMapThreshold(const size_t threshold) {
+
+    assert(threshold == 0 || mDirectMapAllowed);
+
+    mDirectMapThreshold = mDirectMapAllowed ? threshold : 0;
+}
+
+void FreeTreeAllocator::SetDecayTime(const std::chrono::milliseconds decayTime) {
+
+    mDecayTime = decayTime;
+}
+
+size_t FreeTreeAllocator::residentMemory() const {
+
+    return VirtualMemory::ResidentBytes(pBase, mTotalMemory);
+}
+
+size_t FreeTreeAllocator::freeBlocks() const {
+
+    size_t count = 0;
+    ForEachNode([&count](TreeNode*) { ++count;});
+
+    return count;
+}
+
+void* FreeTreeAllocator::AllocateDirect(const size_t size, const size_t align) {
+
+    size_t pageSize = VirtualMemory::PageSize();
+    size_t mapSize = (sizeof(MapHeader) + align - 1 + size + pageSize - 1) & ~(pageSize - 1);
+
+    void *mem = VirtualMemory::MapPages(mapSize);
+    if (mem == nullptr)
+    {
+        throw std::overflow_error("Free tree allocator could not map memory for a direct mapped allocation.");
+    }
+
+    uintptr_t mapAddress = reinterpret_cast<uintptr_t>(mem);
+    uintptr_t alignedAddress = mapAddress + sizeof(MapHeader);
+    alignedAddress += getAlignmentAdjustment(alignedAddress, align);
+
+    MapHeader *header = DirectHeader(reinterpret_cast<void*>(alignedAddress));
+    *header = {nullptr, pMappings, mapSize, alignedAddress - mapAddress};
+    if (pMappings)
+    {
+        pMappings->prev = header;
+    }
+    pMappings = header;
+
+    mDirectMappedMemory += mapSize;
+
+    return reinterpret_cast<void*>(alignedAddress);
+}
+
+void FreeTreeAllocator::FreeDirect(MapHeader *header) {
+
+    if (header->prev)
+    {
+        header->prev->next = header->next;
+    }
+    else
+    {
+        pMappings = header->next;
+    }
+    if (header->next)
+    {
+        header->next->prev = header->prev;
+    }
+
+    mDirectMappedMemory -= header->mapSize;
+
+    VirtualMemory::UnmapPages(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(header) + sizeof(MapHeader) - header->offset), header->mapSize);
+}
+
+void FreeTreeAllocator::Decay() {
+
+    if (mDecayTime.count() > 0 && std::chrono::steady_clock::now() - mLastTrim >= mDecayTime)
+    {
+        Trim();
+    }
+}
+
+void FreeTreeAllocator::RaiseZeroedAddress(const uintptr_t address) {
+
+    mZeroedAddress = std::max(mZeroedAddress, std::min(address, reinterpret_cast<uintptr_t>(pBase) + mTotalMemory));
+}
+
+FreeTreeAllocator::State FreeTreeAllocator::SaveState() const {
+
+    return {ToOffset(pRoot), mUsedMemory, mMaxUsedMemory};
+}
+
+void FreeTreeAllocator::LoadState(const State &state) {
+
+    pRoot = Node(state.root);
+    mUsedMemory = state.usedMemory;
+    mMaxUsedMemory = state.maxUsedMemory;
+}
+
+void FreeTreeAllocator::InsertFreeRegion(const uintptr_t address, const size_t size) {
+
+    TreeNode *newNode = new (reinterpret_cast<void*>(address)) TreeNode(size);
 
     // try merge adjacent nodes
     auto [leftNode, rightNode] = FindNeighbors(newNode);
@@ -91,12 +449,6 @@ void FreeTreeAllocator::Free(void* ptr) {
     }
 }
 
-void FreeTreeAllocator::Clear() {
-    
-    pRoot = new (pBase) TreeNode(mTotalMemory);
-    mUsedMemory = 0;
-}
-
 FreeTreeAllocator::TreeNode* FreeTreeAllocator::FindNode(const size_t size, TreeNode *root) {
 
     if (!root || root->maxSize < size)
@@ -109,12 +461,13 @@ FreeTreeAllocator::TreeNode* FreeTreeAllocator::FindNode(const size_t size, Tree
         return root;
     }
 
-    if (root->left && root->left->maxSize >= size)
+    TreeNode *left = Node(root->left);
+    if (left && left->maxSize >= size)
     {
-        return FindNode(size, root->left);
+        return FindNode(size, left);
     }
 
-    return FindNode(size, root->right);
+    return FindNode(size, Node(root->right));
 
     // size_t leftMax = root->left ? root->left->maxSize : 0;
     // size_t rightMax = root->right ? root->right->maxSize : 0;
@@ -146,52 +499,52 @@ void FreeTreeAllocator::InsertNode(TreeNode *newNode) {
 
         if (reinterpret_cast<uintptr_t>(newNode) < reinterpret_cast<uintptr_t>(curr))
         {
-            curr = curr->left;
+            curr = Node(curr->left);
         }
         else
         {
-            curr = curr->right;
+            curr = Node(curr->right);
         }
     }
 
-    newNode->parent = prev;
+    newNode->parent = ToOffset(prev);
     if (reinterpret_cast<uintptr_t>(newNode) < reinterpret_cast<uintptr_t>(prev))
     {
-        prev->left = newNode;
+        prev->left = ToOffset(newNode);
     }
     else
     {
-        prev->right = newNode;
+        prev->right = ToOffset(newNode);
     }
 }
 
 void FreeTreeAllocator::RemoveNode(TreeNode *node) {
 
     // Node from which to start the maxSize update
-    TreeNode *sizeUpdateNode = node->parent;
+    TreeNode *sizeUpdateNode = Node(node->parent);
     
-    if (!node->left)
+    if (node->left == NullOffset)
     {
-        ShiftNodeUp(node, node->right);
+        ShiftNodeUp(node, Node(node->right));
     }
-    else if (!node->right)
+    else if (node->right == NullOffset)
     {
-        ShiftNodeUp(node, node->left);
+        ShiftNodeUp(node, Node(node->left));
     }
     else
     {
-        TreeNode *nextNode = node->right;
-        while (nextNode->left)
+        TreeNode *nextNode = Node(node->right);
+        while (nextNode->left != NullOffset)
         {
-            nextNode = nextNode->left;
+            nextNode = Node(nextNode->left);
         }
 
-        if (nextNode->parent != node)
+        if (Node(nextNode->parent) != node)
         {
-            sizeUpdateNode = nextNode->parent;
-            ShiftNodeUp(nextNode, nextNode->right);
+            sizeUpdateNode = Node(nextNode->parent);
+            ShiftNodeUp(nextNode, Node(nextNode->right));
             nextNode->right = node->right;
-            nextNode->right->parent = nextNode;
+            Node(nextNode->right)->parent = ToOffset(nextNode);
         }
         else
         {
@@ -199,7 +552,7 @@ void FreeTreeAllocator::RemoveNode(TreeNode *node) {
         }
         ShiftNodeUp(node, nextNode);
         nextNode->left = node->left;
-        nextNode->left->parent = nextNode;
+        Node(nextNode->left)->parent = ToOffset(nextNode);
     }
 
     UpdateMaxSize(sizeUpdateNode);
@@ -213,23 +566,55 @@ void FreeTreeAllocator::ReplaceNode(TreeNode *target, TreeNode *newNode) {
     }
     else
     {
+        TreeNode *parent = Node(target->parent);
         newNode->parent = target->parent;
-        target == target->parent->left ? target->parent->left = newNode : target->parent->right = newNode;
+        target == Node(parent->left) ? parent->left = ToOffset(newNode) : parent->right = ToOffset(newNode);
     }
 
-    if (target->left)
+    if (target->left != NullOffset)
     {
         newNode->left = target->left;
-        newNode->left->parent = newNode;
+        Node(newNode->left)->parent = ToOffset(newNode);
     }
 
-    if (target->right)
+    if (target->right != NullOffset)
     {
         newNode->right = target->right;
-        newNode->right->parent = newNode;
+        Node(newNode->right)->parent = ToOffset(newNode);
+    }
+
+    UpdateMaxSize(newNode);
+}
+
+void FreeTreeAllocator::MoveNode(TreeNode *node, void *address, const size_t newSize) {
+
+    // The new position may overlap the old node, so keep a copy of its links
+    TreeNode oldNode = *node;
+    bool isRoot = node == pRoot;
+    bool isLeft = !isRoot && node == Node(Node(node->parent)->left);
+
+    TreeNode *newNode = new (address) TreeNode(newSize, oldNode.parent, oldNode.left, oldNode.right);
+
+    if (isRoot)
+    {
+        pRoot = newNode;
+    }
+    else
+    {
+        isLeft ? Node(oldNode.parent)->left = ToOffset(newNode) : Node(oldNode.parent)->right = ToOffset(newNode);
+    }
+
+    if (oldNode.left != NullOffset)
+    {
+        Node(oldNode.left)->parent = ToOffset(newNode);
+    }
+
+    if (oldNode.right != NullOffset)
+    {
+        Node(oldNode.right)->parent = ToOffset(newNode);
     }
 
-    UpdateMaxSize(newNode->parent);
+    UpdateMaxSize(newNode);
 }
 
 void FreeTreeAllocator::ShiftNodeUp(TreeNode *target, TreeNode *node) {
@@ -243,13 +628,13 @@ void FreeTreeAllocator::ShiftNodeUp(TreeNode *target, TreeNode *node) {
     {
         pRoot = node;
     }    
-    else if (target == target->parent->left)
+    else if (target == Node(Node(target->parent)->left))
     {
-        target->parent->left = node;
+        Node(target->parent)->left = ToOffset(node);
     }
     else
     {
-        target->parent->right = node;
+        Node(target->parent)->right = ToOffset(node);
     }
 }
 
@@ -258,17 +643,17 @@ void FreeTreeAllocator::UpdateMaxSize(TreeNode *node) {
     while (node)
     {
         node->maxSize = node->size;
-        if (node->left)
+        if (node->left != NullOffset)
         {
-            node->maxSize = std::max(node->maxSize, node->left->maxSize);
+            node->maxSize = std::max(node->maxSize, Node(node->left)->maxSize);
         }
 
-        if (node->right)
+        if (node->right != NullOffset)
         {
-            node->maxSize = std::max(node->maxSize, node->right->maxSize);
+            node->maxSize = std::max(node->maxSize, Node(node->right)->maxSize);
         }
 
-        node = node->parent;
+        node = Node(node->parent);
     }
 }
 
@@ -280,12 +665,12 @@ std::pair<FreeTreeAllocator::TreeNode*, FreeTreeAllocator::TreeNode*> FreeTreeAl
         if (reinterpret_cast<uintptr_t>(node) < reinterpret_cast<uintptr_t>(curr))
         {
             right = curr;
-            curr = curr->left;
+            curr = Node(curr->left);
         }
         else
         {
             left = curr;
-            curr = curr->right;
+            curr = Node(curr->right);
         }
     }
 
@@ -296,7 +681,7 @@ std::pair<FreeTreeAllocator::TreeNode*, FreeTreeAllocator::TreeNode*> FreeTreeAl
 void FreeTreeAllocator::PrintTree() {
 
     std::function<void(std::string, TreeNode*, bool)> printTree;
-    printTree = [&printTree](std::string prefix, TreeNode *root, bool isLeft) {
+    printTree = [this, &printTree](std::string prefix, TreeNode *root, bool isLeft) {
 
         if (root == nullptr)
         {
@@ -307,8 +692,8 @@ void FreeTreeAllocator::PrintTree() {
         std::cout << (isLeft ? "├──" : "└──" );
         std::cout << root->size << ":" << root->maxSize << '\n';
         
-        printTree(prefix + (isLeft ? "│   " : "    "), root->left, true);
-        printTree(prefix + (isLeft ? "│   " : "    "), root->right, false);
+        printTree(prefix + (isLeft ? "│   " : "    "), Node(root->left), true);
+        printTree(prefix + (isLeft ? "│   " : "    "), Node(root->right), false);
     
     };
 
@@ -3,6 +3,9 @@
 
 #include "allocator.h"
 
+#include <chrono>
+#include <vector>
+
 #include "algorithm"
 
 
@@ -10,9 +13,13 @@
  * 
  * Keeps track of unallocated memory regions with a binary search tree using the start address of the free region as a key.
  * TreeNodes hold the size of the free region and the maximum size of any region in its subtree.
+ * Sizes and links are stored as offset_t offsets from pBase, see ALLOCATOR_COMPACT_METADATA.
  * Allocates new memory from the first memory region large enough.
  * Frees memory by creating a new TreeNode in place of the allocated memory section or merges it with direct neighbors.
  * Clears all allocations by creating a new pRoot TreeNode holding all the managed memory.
+ * With SetMaxPending() frees can be deferred, freed blocks are then collected and coalesced in batches sorted by address.
+ * With SetDirectMapThreshold() huge allocations bypass the tree and get their own mapping from the operating system,
+ * which is unmapped as soon as they are freed, so they neither carve long-lived holes into the managed memory nor keep pages resident.
  * 
  * @class 
  */
@@ -20,38 +27,43 @@ class FreeTreeAllocator : public IAllocator{
 
     struct TreeNode {
 
-        size_t size;
-        size_t maxSize;
-        TreeNode *parent;
-        TreeNode *left;
-        TreeNode *right;
+        // Sizes and links to other nodes are stored as offsets from pBase
+        offset_t size;
+        offset_t maxSize;
+        offset_t parent;
+        offset_t left;
+        offset_t right;
 
-        TreeNode() : size {0}, maxSize {0}, parent {nullptr}, left {nullptr}, right {nullptr} {}
-        TreeNode(const size_t size_, TreeNode *parent_ = nullptr, TreeNode *left_ = nullptr, TreeNode *right_ = nullptr) : 
-            size {size_}, parent {parent_}, left {left_}, right {right_} 
+        TreeNode() : size {0}, maxSize {0}, parent {NullOffset}, left {NullOffset}, right {NullOffset} {}
+        TreeNode(const size_t size_, const offset_t parent_ = NullOffset, const offset_t left_ = NullOffset, const offset_t right_ = NullOffset) : 
+            size {static_cast<offset_t>(size_)}, maxSize {static_cast<offset_t>(size_)}, parent {parent_}, left {left_}, right {right_} 
         {
-            maxSize = size;
-            if (left)
-            {
-                maxSize = std::max(maxSize, left->maxSize);
-            }
-            if (right)
-            {
-                maxSize = std::max(maxSize, right->maxSize);
-            }
         }
     };
 
     struct AllocHeader {
 
-        size_t size;
-        size_t adjustment;
+        offset_t size;
+        offset_t adjustment;
+
+        AllocHeader(const size_t size_, const size_t adjustment_) : size {static_cast<offset_t>(size_)}, adjustment {static_cast<offset_t>(adjustment_)} {}
+    };
+
+    // Placed in front of a direct mapped allocation, links all mappings so Clear() and the destructor can unmap them
+    struct MapHeader {
 
-        AllocHeader(const size_t size_, const size_t adjustment_) : size {size_}, adjustment {adjustment} {}
+        MapHeader *prev;
+        MapHeader *next;
+        // Size of the whole mapping and distance of the allocated memory from its start
+        size_t mapSize;
+        size_t offset;
     };
 
 public:
 
+    // Smallest allocation taken from the tree, smaller ones are padded so the block can hold a TreeNode once it is freed
+    static constexpr size_t MinAllocationSize = sizeof(TreeNode) - sizeof(AllocHeader);
+
     FreeTreeAllocator() = delete;
 
     /* @brief Constructor that allocates the managed memory portion and calls Clear() to reset the free tree.
@@ -61,11 +73,12 @@ public:
      */
     explicit FreeTreeAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
 
-    /* @brief Default destructor that does nothing.
+    /* @brief Destructor that unmaps all direct mapped allocations.
      */
     ~FreeTreeAllocator();
     
-    /* @brief Allocates a properly aligned section of memory from the first TreeNode large enough for the allocation. 
+    /* @brief Allocates a properly aligned section of memory from the first TreeNode large enough for the allocation,
+     * or from a new mapping if size reaches the direct map threshold.
      *  
      * @param size    The size of the allocated memory section.
      * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
@@ -74,23 +87,181 @@ public:
      */
     void* Allocate(const size_t size, const size_t align = 1) override;
 
+    /* @brief Allocates a zero filled memory section, clearing only the part below the highest address ever written to.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
     /* @brief Frees the allocated memory section at ptr and creates a new TreeNode at that position or merges the new node with direct neighbors.
+     * Direct mapped allocations, recognized by lying outside the managed memory, are unmapped.
      * 
      * @param ptr    Pointer to the memory position to free.
      */
     void  Free(void* ptr) override;
 
-    /* @brief Frees all the allocated memory by creating a new pRoot TreeNode containing the whole memory.
+    /* @brief Frees all the allocated memory by creating a new pRoot TreeNode containing the whole memory and unmapping all direct mapped allocations.
      */
     void  Clear() override;
 
+    /* @brief Returns the usable size of an allocated memory section stored in its AllocHeader.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Grows an allocated memory section in place by absorbing the free region directly behind it.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * @param newSize    The requested new size in bytes.
+     * 
+     * @return True if the memory section at ptr now holds at least newSize bytes.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Checks if a pointer lies inside the managed memory space or one of the direct mapped allocations.
+     *
+     * @param ptr    Pointer to check.
+     * 
+     * @return True if ptr was allocated by this allocator.
+     */
+    bool  Owns(const void* ptr) const override;
+
+    /* @brief Gives the pages inside all free regions back to the operating system, keeping the TreeNode at the start of each region intact.
+     *
+     * @param lazy    Let the operating system reclaim the pages only under memory pressure (MADV_FREE).
+     * 
+     * @return The number of bytes given back.
+     */
+    size_t Trim(const bool lazy = false);
+
+    /* @brief Lets Free() defer coalescing and tree insertion of freed blocks until maxPending blocks were collected, 
+     * an allocation finds no large enough region, or FlushPending() or Trim() is called.
+     *
+     * @param maxPending    Maximum number of pending blocks, zero inserts every freed block right away.
+     */
+    void  SetMaxPending(const size_t maxPending);
+
+    /* @brief Coalesces all pending blocks with each other and with their neighbors in the tree.
+     */
+    void  FlushPending();
+
+    /* @brief Lets Allocate() map allocations of at least threshold bytes directly from the operating system instead of taking them from the tree.
+     * The mappings are private to this process, so allocators built on externally provided memory, which may be shared with other processes
+     * or persisted, never map directly and ignore the threshold.
+     *
+     * @param threshold    Minimum size of a direct mapped allocation in bytes, zero allocates everything from the tree.
+     */
+    void  SetDirectMapThreshold(const size_t threshold);
+
+    /* @brief Lets Free() call Trim() once the decay time has passed since the last trim.
+     *
+     * @param decayTime    Minimum time between two trims, zero disables trimming from Free().
+     */
+    void  SetDecayTime(const std::chrono::milliseconds decayTime);
+
+    /* @brief Returns the number of bytes of the managed memory that are resident in physical memory.
+     */
+    size_t residentMemory() const;
+
+    /* @brief Returns the number of free regions in the tree, walks the whole tree. Pending blocks are not counted.
+     */
+    size_t freeBlocks() const;
+
+    /* @brief Returns the size in bytes of the largest free region in the tree, which the root keeps track of. Pending blocks are not counted.
+     */
+    size_t largestFreeBlock() const { return pRoot ? pRoot->maxSize : 0;}
+
+    /* @brief Returns the number of bytes currently mapped for direct mapped allocations, including headers and page rounding.
+     * Direct mapped allocations are not counted in usedMemory().
+     */
+    size_t directMappedMemory() const { return mDirectMappedMemory;}
+
     /* @brief Draws a representation of the tree to console output, showing the size and maxSize of each node.
      */
     void PrintTree();
 
 
+protected:
+
+    /* @brief Allocator state that is not stored in the managed memory itself, as offsets so it can be kept together with the memory.
+     */
+    struct State {
+
+        offset_t root;
+        size_t usedMemory;
+        size_t maxUsedMemory;
+    };
+
+    /* @brief Constructor for derived allocators that manage an externally provided memory portion, which is not freed on destruction.
+     * Does not call Clear(), the derived allocator must either call Clear() or restore a previous state with LoadState().
+     *
+     * @param base    Pointer to the beginning of the memory portion.
+     * @param totalMemory    The size of the memory portion in bytes.
+     */
+    FreeTreeAllocator(void *base, const size_t totalMemory);
+
+    /* @brief Returns the current state of the allocator.
+     */
+    State SaveState() const;
+
+    /* @brief Restores a state previously returned by SaveState() for the same memory content, which may be mapped at a different address.
+     *
+     * @param state    The state to restore.
+     */
+    void LoadState(const State &state);
+
+
 private:
 
+    /* @brief Maps a new region for a single allocation and links it into the list of direct mapped allocations.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateDirect(const size_t size, const size_t align);
+
+    /* @brief Unlinks and unmaps a direct mapped allocation.
+     *
+     * @param header    The MapHeader in front of the allocated memory.
+     */
+    void FreeDirect(MapHeader *header);
+
+    /* @brief Returns the MapHeader in front of a direct mapped allocation.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    static MapHeader* DirectHeader(const void* ptr) { return reinterpret_cast<MapHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(MapHeader));}
+
+    /* @brief Calls Trim() if decay is enabled and the decay time has passed since the last trim.
+     */
+    void Decay();
+
+    /* @brief Raises mZeroedAddress to address, clipped to the end of the managed memory.
+     *
+     * @param address    End of a memory section that may be written to from now on.
+     */
+    void RaiseZeroedAddress(const uintptr_t address);
+
+    /* @brief Calls func for every node of the tree in address order, following parent links instead of recursing.
+     *
+     * @param func    Callable taking a TreeNode pointer.
+     */
+    template<typename Func>
+    void ForEachNode(Func func) const;
+
+    /* @brief Inserts a free region into the tree, merging it with its direct neighbors.
+     *
+     * @param address    Start address of the free region.
+     * @param size    Size of the free region in bytes.
+     */
+    void InsertFreeRegion(const uintptr_t address, const size_t size);
+
     /* @brief Finds the first free region larger than size bytes.
      *
      * @param size    Required size of the free memory region in bytes
@@ -119,6 +290,14 @@ private:
      */
     void ReplaceNode(TreeNode *target, TreeNode *newNode);
 
+    /* @brief Moves a node to a new address inside its free region without changing its position in the tree.
+     *
+     * @param node    Pointer to the node to be moved.
+     * @param address    The new address of the node, may overlap the old node.
+     * @param newSize    The size of the free region at the new address.
+     */
+    void MoveNode(TreeNode *node, void *address, const size_t newSize);
+
     /* @brief Moves a node to replace another node higher up the tree.
      *
      * @param target    Pointer to the node to be replaces.
@@ -132,6 +311,12 @@ private:
      */
     void UpdateMaxSize(TreeNode *node);
 
+    /* @brief Converts the offset of a node to a pointer.
+     *
+     * @param offset    Offset of the node from pBase or NullOffset.
+     */
+    TreeNode* Node(const offset_t offset) const { return FromOffset<TreeNode>(offset);}
+
     /* @brief Searches the tree for the direct neighbors of the given node.
      *
      * @param node    Pointers to the left and right neighbors of the node.
@@ -140,4 +325,20 @@ private:
 
 
     TreeNode* pRoot;
+    // All memory from this address on is known to be zero, externally provided memory is never assumed to be zero
+    uintptr_t mZeroedAddress;
+
+    // Freed blocks not yet inserted into the tree
+    std::vector<TreeNode*> mPending;
+    size_t mMaxPending;
+
+    // Direct mapped allocations, unlike the tree they never live inside the managed memory
+    MapHeader* pMappings;
+    // False for externally provided memory, see SetDirectMapThreshold()
+    bool mDirectMapAllowed;
+    size_t mDirectMapThreshold;
+    size_t mDirectMappedMemory;
+
+    std::chrono::milliseconds mDecayTime;
+    std::chrono::steady_clock::time_point mLastTrim;
 };
\ No newline at end of file
@@ -0,0 +1,446 @@
+/* Replacement of malloc, free and operator new/delete by the allocators of this repository, to be preloaded into unmodified programs.
+ *
+ * Small allocations come from one PoolAllocator per size class, medium allocations from a FreeTreeAllocator, both inside one mapping reserved at start,
+ * large allocations and everything that does not fit anymore get their own mapping. Every allocator is guarded by its own mutex.
+ * Nothing in here throws, out of memory is reported by returning nullptr, except for operator new.
+ *
+ * Only compiled with ALLOCATOR_MALLOC_SHIM defined, so building all sources into the test program does not replace its malloc, see README.md.
+ */
+#if defined(ALLOCATOR_MALLOC_SHIM)
+
+#include "free_tree_allocator.h"
+#include "pool_allocator.h"
+#include "virtual_memory.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+
+
+namespace {
+
+    constexpr size_t KB = 1024;
+    constexpr size_t MB = KB * KB;
+
+    // Alignment of all memory returned by malloc
+    constexpr size_t Alignment = alignof(std::max_align_t);
+
+    constexpr size_t SizeClasses[] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+    constexpr size_t NumSizeClasses = sizeof(SizeClasses) / sizeof(SizeClasses[0]);
+    constexpr size_t MaxPoolSize = SizeClasses[NumSizeClasses - 1];
+
+    // A multiple of every size class, so the pools lie back to back and the pool of a pointer follows from its offset
+    constexpr size_t PoolMemory = 24 * MB;
+    constexpr size_t TreeMemory = 512 * MB;
+    constexpr size_t MaxTreeSize = 256 * KB;
+
+    // Placed in front of allocations with their own mapping
+    struct MapHeader {
+
+        size_t mapSize;
+        // Distance of the allocated memory from the start of the mapping
+        size_t offset;
+    };
+
+
+    /* @brief Hands out consecutive parts of one mapping to the pools and the tree, never frees.
+     *
+     * @class
+     */
+    class RegionAllocator : public IAllocator{
+
+    public:
+
+        explicit RegionAllocator(const size_t totalMemory) :
+            IAllocator(VirtualMemory::MapPages(totalMemory), totalMemory),
+            mTopOffset {0}
+        {
+        }
+
+        void* Allocate(const size_t size, const size_t align = 1) override {
+
+            uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + mTopOffset;
+            address += getAlignmentAdjustment(address, align);
+            assert(address + size <= reinterpret_cast<uintptr_t>(pBase) + mTotalMemory);
+
+            mTopOffset = address + size - reinterpret_cast<uintptr_t>(pBase);
+
+            return reinterpret_cast<void*>(address);
+        }
+
+        void Free(void* /*ptr*/) override {
+
+        }
+
+        void Clear() override {
+
+            mTopOffset = 0;
+        }
+
+
+    private:
+
+        size_t mTopOffset;
+    };
+
+
+    // Pools of different size classes are used by different threads, keep their mutexes on separate cache lines
+    struct alignas(64) LockedPool {
+
+        std::mutex mutex;
+        PoolAllocator *pool = nullptr;
+    };
+
+
+    /* @brief All allocators of the shim, constructed on the first allocation and never destroyed, as memory may be freed until the very end of the process.
+     *
+     * @class
+     */
+    class Heap {
+
+    public:
+
+        Heap() :
+            mRegion {NumSizeClasses * PoolMemory + TreeMemory},
+            pTree {nullptr}
+        {
+            if (mRegion.base() == nullptr)
+            {
+                return;
+            }
+
+            for (size_t i = 0; i < NumSizeClasses; i++)
+            {
+                mPools[i].pool = new (mPoolStorage[i]) PoolAllocator(PoolMemory, SizeClasses[i], &mRegion);
+            }
+
+            pTree = new (mTreeStorage) FreeTreeAllocator(TreeMemory, &mRegion);
+            pTree->SetDecayTime(std::chrono::milliseconds(1000));
+
+            size_t sizeClass = 0;
+            for (size_t i = 0; i <= MaxPoolSize / Alignment; i++)
+            {
+                while (SizeClasses[sizeClass] < i * Alignment)
+                {
+                    ++sizeClass;
+                }
+                mClassOf[i] = static_cast<uint8_t>(sizeClass);
+            }
+        }
+
+        void* Allocate(size_t size, const size_t align, const bool zeroed = false) {
+
+            size = std::max(size, size_t{1});
+            if (pTree == nullptr)
+            {
+                return AllocateMapped(size, align);
+            }
+
+            // Pools and tree are checked for space first, as running out of memory throws and exceptions allocate memory themselves
+            if (size <= MaxPoolSize && align <= Alignment)
+            {
+                size_t sizeClass = mClassOf[(size + Alignment - 1) / Alignment];
+                LockedPool &locked = mPools[sizeClass];
+                std::lock_guard<std::mutex> lock(locked.mutex);
+
+                if (locked.pool->usedMemory() + SizeClasses[sizeClass] <= locked.pool->totalMemory())
+                {
+                    return zeroed ? locked.pool->AllocateZeroed(size, Alignment) : locked.pool->Allocate(size, Alignment);
+                }
+            }
+
+            if (size <= MaxTreeSize)
+            {
+                // Multiples of the alignment keep all nodes of the tree aligned
+                size_t treeSize = (size + Alignment - 1) & ~(Alignment - 1);
+                size_t treeAlign = std::max(align, Alignment);
+
+                std::lock_guard<std::mutex> lock(mTreeMutex);
+                if (pTree->largestFreeBlock() >= treeSize + treeAlign + 64)
+                {
+                    return zeroed ? pTree->AllocateZeroed(treeSize, treeAlign) : pTree->Allocate(treeSize, treeAlign);
+                }
+            }
+
+            // Fresh mappings are always zero
+            return AllocateMapped(size, align);
+        }
+
+        void Free(void* ptr) {
+
+            if (ptr == nullptr)
+            {
+                return;
+            }
+
+            size_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(mRegion.base());
+            if (pTree == nullptr || offset >= mRegion.totalMemory())
+            {
+                MapHeader *header = reinterpret_cast<MapHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(MapHeader));
+                VirtualMemory::UnmapPages(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) - header->offset), header->mapSize);
+            }
+            else if (offset < NumSizeClasses * PoolMemory)
+            {
+                LockedPool &locked = mPools[offset / PoolMemory];
+                std::lock_guard<std::mutex> lock(locked.mutex);
+                locked.pool->Free(ptr);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(mTreeMutex);
+                pTree->Free(ptr);
+            }
+        }
+
+        void* Reallocate(void* ptr, const size_t size) {
+
+            if (ptr == nullptr)
+            {
+                return Allocate(size, Alignment);
+            }
+
+            if (size == 0)
+            {
+                Free(ptr);
+                return nullptr;
+            }
+
+            size_t usableSize = UsableSize(ptr);
+            if (size <= usableSize)
+            {
+                return ptr;
+            }
+
+            if (InTree(ptr))
+            {
+                std::lock_guard<std::mutex> lock(mTreeMutex);
+                if (size <= MaxTreeSize && pTree->TryExpand(ptr, (size + Alignment - 1) & ~(Alignment - 1)))
+                {
+                    return ptr;
+                }
+            }
+
+            void *mem = Allocate(size, Alignment);
+            if (mem != nullptr)
+            {
+                std::memcpy(mem, ptr, usableSize);
+                Free(ptr);
+            }
+
+            return mem;
+        }
+
+        size_t UsableSize(const void* ptr) const {
+
+            if (ptr == nullptr)
+            {
+                return 0;
+            }
+
+            size_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(mRegion.base());
+            if (pTree == nullptr || offset >= mRegion.totalMemory())
+            {
+                const MapHeader *header = reinterpret_cast<const MapHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(MapHeader));
+                return header->mapSize - header->offset;
+            }
+            if (offset < NumSizeClasses * PoolMemory)
+            {
+                return SizeClasses[offset / PoolMemory];
+            }
+
+            // The header of the allocation is only written by the owner of ptr, no lock needed
+            return pTree->AllocatedSize(ptr);
+        }
+
+        void LockAll() {
+
+            for (LockedPool &locked : mPools)
+            {
+                locked.mutex.lock();
+            }
+            mTreeMutex.lock();
+        }
+
+        void UnlockAll() {
+
+            mTreeMutex.unlock();
+            for (LockedPool &locked : mPools)
+            {
+                locked.mutex.unlock();
+            }
+        }
+
+
+    private:
+
+        bool InTree(const void* ptr) const {
+
+            size_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(mRegion.base());
+            return pTree != nullptr && offset >= NumSizeClasses * PoolMemory && offset < mRegion.totalMemory();
+        }
+
+        static void* AllocateMapped(const size_t size, size_t align) {
+
+            align = std::max(align, Alignment);
+            size_t pageSize = VirtualMemory::PageSize();
+            size_t mapSize = (sizeof(MapHeader) + align - 1 + size + pageSize - 1) & ~(pageSize - 1);
+            if (mapSize < size)
+            {
+                return nullptr;
+            }
+
+            void *mem = VirtualMemory::MapPages(mapSize);
+            if (mem == nullptr)
+            {
+                return nullptr;
+            }
+
+            uintptr_t mapAddress = reinterpret_cast<uintptr_t>(mem);
+            uintptr_t alignedAddress = (mapAddress + sizeof(MapHeader) + align - 1) & ~(align - 1);
+            *reinterpret_cast<MapHeader*>(alignedAddress - sizeof(MapHeader)) = {mapSize, alignedAddress - mapAddress};
+
+            return reinterpret_cast<void*>(alignedAddress);
+        }
+
+
+        RegionAllocator mRegion;
+
+        LockedPool mPools[NumSizeClasses];
+        alignas(PoolAllocator) unsigned char mPoolStorage[NumSizeClasses][sizeof(PoolAllocator)];
+
+        alignas(64) std::mutex mTreeMutex;
+        FreeTreeAllocator *pTree;
+        alignas(FreeTreeAllocator) unsigned char mTreeStorage[sizeof(FreeTreeAllocator)];
+
+        // Size class of every multiple of the alignment up to MaxPoolSize
+        uint8_t mClassOf[MaxPoolSize / Alignment + 1];
+    };
+
+
+    Heap& GetHeap() {
+
+        // Static storage instead of a static object, so the heap outlives all static destructors that may still free memory
+        alignas(Heap) static unsigned char storage[sizeof(Heap)];
+        static Heap *heap = new (storage) Heap();
+
+        return *heap;
+    }
+
+    // A forked child must not inherit a mutex locked by another thread of the parent
+    __attribute__((constructor)) void RegisterForkHandlers() {
+
+        GetHeap();
+        pthread_atfork([]() { GetHeap().LockAll();}, []() { GetHeap().UnlockAll();}, []() { GetHeap().UnlockAll();});
+    }
+
+    bool IsValidAlignment(const size_t align) {
+
+        return align >= sizeof(void*) && (align & (align - 1)) == 0;
+    }
+
+    void* NewOrThrow(const size_t size, const size_t align) {
+
+        void *mem = GetHeap().Allocate(size, align);
+        if (mem == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return mem;
+    }
+}
+
+
+extern "C" {
+
+void* malloc(size_t size) {
+
+    return GetHeap().Allocate(size, Alignment);
+}
+
+void free(void* ptr) {
+
+    GetHeap().Free(ptr);
+}
+
+void* calloc(size_t count, size_t size) {
+
+    if (size != 0 && count > std::numeric_limits<size_t>::max() / size)
+    {
+        errno = ENOMEM;
+        return nullptr;
+    }
+
+    return GetHeap().Allocate(count * size, Alignment, true);
+}
+
+void* realloc(void* ptr, size_t size) {
+
+    return GetHeap().Reallocate(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t align, size_t size) {
+
+    if (!IsValidAlignment(align))
+    {
+        return EINVAL;
+    }
+
+    void *mem = GetHeap().Allocate(size, align);
+    if (mem == nullptr)
+    {
+        return ENOMEM;
+    }
+
+    *ptr = mem;
+
+    return 0;
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+
+    return GetHeap().Allocate(size, std::max(align, Alignment));
+}
+
+void* memalign(size_t align, size_t size) {
+
+    return GetHeap().Allocate(size, std::max(align, Alignment));
+}
+
+void* valloc(size_t size) {
+
+    return GetHeap().Allocate(size, VirtualMemory::PageSize());
+}
+
+size_t malloc_usable_size(void* ptr) {
+
+    return GetHeap().UsableSize(ptr);
+}
+
+}
+
+
+void* operator new(size_t size) { return NewOrThrow(size, Alignment);}
+void* operator new[](size_t size) { return NewOrThrow(size, Alignment);}
+void* operator new(size_t size, std::align_val_t align) { return NewOrThrow(size, static_cast<size_t>(align));}
+void* operator new[](size_t size, std::align_val_t align) { return NewOrThrow(size, static_cast<size_t>(align));}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return GetHeap().Allocate(size, Alignment);}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return GetHeap().Allocate(size, Alignment);}
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return GetHeap().Allocate(size, static_cast<size_t>(align));}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return GetHeap().Allocate(size, static_cast<size_t>(align));}
+
+void operator delete(void* ptr) noexcept { GetHeap().Free(ptr);}
+void operator delete[](void* ptr) noexcept { GetHeap().Free(ptr);}
+void operator delete(void* ptr, size_t) noexcept { GetHeap().Free(ptr);}
+void operator delete[](void* ptr, size_t) noexcept { GetHeap().Free(ptr);}
+void operator delete(void* ptr, std::align_val_t) noexcept { GetHeap().Free(ptr);}
+void operator delete[](void* ptr, std::align_val_t) noexcept { GetHeap().Free(ptr);}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { GetHeap().Free(ptr);}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { GetHeap().Free(ptr);}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { GetHeap().Free(ptr);}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { GetHeap().Free(ptr);}
+
+#endif
@@ -0,0 +1,49 @@
+#include "persistent_allocator.h"
+#include <stdexcept>
+
+
+PersistentAllocator::PersistentAllocator(const char *path, const size_t totalMemory) :
+    MappedFile(path, HeaderSize + totalMemory),
+    FreeTreeAllocator(static_cast<char*>(data()) + HeaderSize, size() > HeaderSize ? size() - HeaderSize : 0)
+{
+    Header *heapHeader = header();
+
+    if (created())
+    {
+        Clear();
+        heapHeader->magic = Magic;
+        heapHeader->offsetSize = sizeof(offset_t);
+        heapHeader->totalMemory = mTotalMemory;
+        heapHeader->root = NullOffset;
+        Flush();
+        return;
+    }
+
+    if (size() <= HeaderSize || heapHeader->magic != Magic || heapHeader->offsetSize != sizeof(offset_t) || heapHeader->totalMemory != mTotalMemory)
+    {
+        throw std::runtime_error(std::string(path) + " does not contain a compatible persistent heap.");
+    }
+
+    LoadState(heapHeader->state);
+}
+
+PersistentAllocator::~PersistentAllocator() {
+
+    Flush();
+}
+
+void PersistentAllocator::Flush() {
+
+    // Pending blocks are only known to this process and would leak in the file
+    FlushPending();
+    header()->state = SaveState();
+    Sync();
+}
+
+void PersistentAllocator::SetRoot(void* ptr) {
+
+    // Only the managed memory is persisted, direct mappings are accepted by Owns() but never stored in the file
+    assert(ptr == nullptr || IAllocator::Owns(ptr));
+
+    header()->root = ToOffset(ptr);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+
+#include "free_tree_allocator.h"
+#include "virtual_memory.h"
+
+
+/* @brief File backed FreeTreeAllocator, whose heap survives the process and can be reopened at a different address.
+ * 
+ * Maps the file into memory and manages everything behind a small header with a FreeTreeAllocator.
+ * All allocator metadata is stored as offsets from pBase, the header keeps the allocator state and the offset of one root object.
+ * Data placed in the heap must link to other objects in the heap with offsets, see OffsetOf() and PointerAt(), and reach them from the root object.
+ * Writes the allocator state to the header and syncs the file on Flush() and on destruction.
+ * 
+ * @class 
+ */
+class PersistentAllocator : private MappedFile, public FreeTreeAllocator{
+
+    struct Header {
+
+        uint64_t magic;
+        uint64_t offsetSize;
+        uint64_t totalMemory;
+        State state;
+        offset_t root;
+    };
+
+    // Size reserved for the header in front of the managed memory, keeps the managed memory cache line aligned
+    static constexpr size_t HeaderSize = 64;
+    static_assert(sizeof(Header) <= HeaderSize, "Persistent heap header does not fit.");
+
+public:
+
+    PersistentAllocator() = delete;
+
+    /* @brief Constructor that opens the heap stored in a file, or creates a new empty heap if the file does not exist.
+     * Throws std::runtime_error if the file exists but does not hold a heap created with the same offset_t.
+     *
+     * @param path    Path of the file.
+     * @param totalMemory    The size of the managed memory space in bytes of a new heap, ignored when opening an existing heap.
+     */
+    PersistentAllocator(const char *path, const size_t totalMemory);
+
+    /* @brief Destructor that calls Flush().
+     */
+    ~PersistentAllocator();
+
+    /* @brief Writes the allocator state to the header and syncs the whole heap to the file.
+     */
+    void Flush();
+
+    /* @brief Sets the root object, which is the entry point to the data in the heap after reopening it.
+     *
+     * @param ptr    Pointer to the root object in the heap, or nullptr.
+     */
+    void SetRoot(void* ptr);
+
+    /* @brief Returns the root object set with SetRoot(), or nullptr.
+     */
+    template<typename T = void>
+    T* Root() const { return FromOffset<T>(header()->root);}
+
+    /* @brief Converts a pointer into the heap to a position independent offset.
+     *
+     * @param ptr    Pointer into the heap or nullptr.
+     */
+    offset_t OffsetOf(const void* ptr) const { return ToOffset(ptr);}
+
+    /* @brief Converts an offset returned by OffsetOf() to a pointer into the heap as currently mapped.
+     *
+     * @param offset    Offset into the heap.
+     */
+    template<typename T = void>
+    T* PointerAt(const offset_t offset) const { return FromOffset<T>(offset);}
+
+
+private:
+
+    Header* header() const { return static_cast<Header*>(data());}
+
+
+    static constexpr uint64_t Magic = 0x50455253'48454150;
+};
@@ -10,6 +10,7 @@ PoolAllocator::PoolAllocator(const size_t totalMemory, const size_t chunkSize, I
     assert(totalMemory % chunkSize == 0);
 
     mNumChunks = totalMemory / chunkSize;
+    mZeroedAddress = reinterpret_cast<uintptr_t>(pBase) + (mZeroedMemory ? 0 : mTotalMemory);
     Clear();   
 }
 
@@ -22,13 +23,21 @@ void* PoolAllocator::Allocate(const size_t size, const size_t align) {
     assert(size <= mChunkSize);
     assert(mChunkSize % align == 0);
 
-    if(!pHead)
+    void *mem = reinterpret_cast<void*>(pHead);
+    if (pHead)
+    {
+        pHead = pHead->next;
+    }
+    else if (mUntouchedAddress < reinterpret_cast<uintptr_t>(pBase) + mTotalMemory)
+    {
+        mem = reinterpret_cast<void*>(mUntouchedAddress);
+        mUntouchedAddress += mChunkSize;
+        mZeroedAddress = std::max(mZeroedAddress, mUntouchedAddress);
+    }
+    else
     {
         throw std::overflow_error("Pool allocator is out of memory!");
     }
-
-    void *mem = reinterpret_cast<void*>(pHead);
-    pHead = pHead->next;
     
     mUsedMemory += mChunkSize;
     mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
@@ -36,6 +45,20 @@ void* PoolAllocator::Allocate(const size_t size, const size_t align) {
     return mem;
 }
 
+void* PoolAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    uintptr_t zeroedAddress = mZeroedAddress;
+    void *mem = Allocate(size, align);
+
+    // Chunks above the zeroed address were never handed out and still hold the zeros of the fresh memory
+    if (reinterpret_cast<uintptr_t>(mem) < zeroedAddress)
+    {
+        ZeroMemory(mem, mChunkSize);
+    }
+
+    return mem;
+}
+
 void PoolAllocator::Free(void* ptr) {
 
     assert(ptr != nullptr);
@@ -45,15 +68,19 @@ void PoolAllocator::Free(void* ptr) {
     mUsedMemory -= mChunkSize;
 }
 
+size_t PoolAllocator::AllocatedSize(const void* /*ptr*/) const {
+
+    return mChunkSize;
+}
+
+bool PoolAllocator::TryExpand(void* /*ptr*/, const size_t newSize) {
+
+    return newSize <= mChunkSize;
+}
+
 void PoolAllocator::Clear() {
 
     pHead = nullptr;
-    uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + mTotalMemory;
-    for (size_t i = 0; i < mNumChunks; i++)
-    {
-        address -= mChunkSize;
-        pHead = new (reinterpret_cast<void*>(address)) PoolNode(pHead);
-    }
-
+    mUntouchedAddress = reinterpret_cast<uintptr_t>(pBase);
     mUsedMemory = 0;
 }
\ No newline at end of file
@@ -6,10 +6,10 @@
 
 /* @brief Pool implementation of IAllocator.
  * 
- * Splits the managed memory space into chunks of equal size and keeps track of unallocated memory regions with a linked list of PoolNodes.
- * Allocates new memory from pHead of the list.
+ * Splits the managed memory space into chunks of equal size and keeps track of freed chunks with a linked list of PoolNodes.
+ * Allocates new memory from pHead of the list, or the next chunk never handed out since the last Clear() if the list is empty.
  * Frees memory by creating a new PoolNode in place of the allocated memory section and makes it the new pHead.
- * Clears all allocations by creatig a new list of PoolNodes covering the whole memory space.
+ * Clears all allocations by emptying the list and handing out chunks from the beginning of the memory space again, without touching the memory.
  * 
  * @class 
  */
@@ -26,7 +26,7 @@ public:
 
     PoolAllocator() = delete;
 
-    /* @brief Constructor that allocates the managed memory portion and splits it into chunks. Creates a linked list of PoolNodes to track free chunks.
+    /* @brief Constructor that allocates the managed memory portion and splits it into chunks.
      *
      * @param totalMemory    The size of the managed memory space in bytes.
      * @param chunkSize    The size of each allocatable memory region.
@@ -46,20 +46,46 @@ public:
      */
     void* Allocate(const size_t size, const size_t align = 1) override;
 
+    /* @brief Allocates a zero filled chunk, clearing it only if it was handed out before since construction.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
     /* @brief Frees the allocated memory section at ptr and creates a new pHead PoolNode at that position.
      * 
      * @param ptr    Pointer to the memory position to free.
      */
     void  Free(void* ptr) override;
 
-    /* @brief Frees all the allocated memory by creating a new list of PoolNodes covering the whole memory space.
+    /* @brief Frees all the allocated memory by emptying the list of PoolNodes and resetting the first untouched chunk.
      */
     void  Clear() override;
 
+    /* @brief Returns the chunk size, which is the usable size of every allocation.
+     *
+     * @param ptr    Pointer to the allocated chunk.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Succeeds if the new size still fits into the chunk.
+     *
+     * @param ptr    Pointer to the allocated chunk.
+     * @param newSize    The requested new size in bytes.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
 
 private:
 
     PoolNode* pHead;
     size_t mChunkSize;
     size_t mNumChunks;
+    // Chunks from this address on were not handed out since the last Clear()
+    uintptr_t mUntouchedAddress;
+    // All memory from this address on is known to be zero
+    uintptr_t mZeroedAddress;
 };
\ No newline at end of file
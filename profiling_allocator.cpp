@@ -0,0 +1,207 @@
+#include "profiling_allocator.h"
+#include <algorithm>
+#include <cmath>
+#include <execinfo.h>
+#include <fstream>
+#include <ostream>
+
+
+ProfilingAllocator::ProfilingAllocator(IAllocator &allocator, const size_t sampleInterval) :
+    IAllocator(nullptr, allocator.totalMemory()),
+    mAllocator {allocator},
+    mSampleInterval {sampleInterval},
+    mRandom {std::random_device{}()},
+    mSampleDistribution {1.0 / sampleInterval}
+{
+    assert(sampleInterval > 0);
+
+    mBytesUntilSample = static_cast<size_t>(mSampleDistribution(mRandom)) + 1;
+}
+
+ProfilingAllocator::~ProfilingAllocator() {
+
+}
+
+void* ProfilingAllocator::Allocate(const size_t size, const size_t align) {
+
+    void *mem = mAllocator.Allocate(size, align);
+
+    if (size >= mBytesUntilSample)
+    {
+        RecordSample(mem, size);
+    }
+    else
+    {
+        mBytesUntilSample -= size;
+    }
+
+    mUsedMemory = mAllocator.usedMemory();
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return mem;
+}
+
+void* ProfilingAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    void *mem = mAllocator.AllocateZeroed(size, align);
+
+    if (size >= mBytesUntilSample)
+    {
+        RecordSample(mem, size);
+    }
+    else
+    {
+        mBytesUntilSample -= size;
+    }
+
+    mUsedMemory = mAllocator.usedMemory();
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return mem;
+}
+
+void ProfilingAllocator::Free(void* ptr) {
+
+    if (!mLiveSamples.empty())
+    {
+        auto pos = mLiveSamples.find(ptr);
+        if (pos != mLiveSamples.end())
+        {
+            Sample &sample = pos->second;
+            sample.site->liveSamples--;
+            sample.site->liveSampleBytes -= sample.size;
+            sample.site->liveCount -= sample.weight;
+            sample.site->liveBytes -= sample.weight * sample.size;
+            mLiveSamples.erase(pos);
+        }
+    }
+
+    mAllocator.Free(ptr);
+    mUsedMemory = mAllocator.usedMemory();
+}
+
+void ProfilingAllocator::Clear() {
+
+    for (auto &[stack, site] : mCallSites)
+    {
+        site.liveSamples = 0;
+        site.liveSampleBytes = 0;
+        site.liveCount = 0.0;
+        site.liveBytes = 0.0;
+    }
+    mLiveSamples.clear();
+
+    mAllocator.Clear();
+    mUsedMemory = mAllocator.usedMemory();
+}
+
+bool ProfilingAllocator::Owns(const void* ptr) const {
+
+    return mAllocator.Owns(ptr);
+}
+
+size_t ProfilingAllocator::AllocatedSize(const void* ptr) const {
+
+    return mAllocator.AllocatedSize(ptr);
+}
+
+bool ProfilingAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    bool expanded = mAllocator.TryExpand(ptr, newSize);
+
+    // A sample resized in place keeps its weight, frees then subtract the new size
+    auto pos = expanded ? mLiveSamples.find(ptr) : mLiveSamples.end();
+    if (pos != mLiveSamples.end())
+    {
+        Sample &sample = pos->second;
+        sample.site->liveSampleBytes += newSize - sample.size;
+        sample.site->liveBytes += sample.weight * (static_cast<double>(newSize) - static_cast<double>(sample.size));
+        sample.size = newSize;
+    }
+
+    mUsedMemory = mAllocator.usedMemory();
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return expanded;
+}
+
+void ProfilingAllocator::RecordSample(void* ptr, const size_t size) {
+
+    void *frames[MaxFrames];
+    int numFrames = backtrace(frames, MaxFrames);
+
+    // Skip the frames of RecordSample and Allocate
+    std::vector<void*> stack(frames + std::min(numFrames, 2), frames + numFrames);
+    CallSite &site = mCallSites[stack];
+
+    // A sample of size bytes stands for 1 / P(sampled) allocations of that size
+    double weight = 1.0 / (1.0 - std::exp(-static_cast<double>(size) / mSampleInterval));
+
+    site.liveSamples++;
+    site.liveSampleBytes += size;
+    site.totalSamples++;
+    site.totalSampleBytes += size;
+    site.liveCount += weight;
+    site.liveBytes += weight * size;
+    site.totalCount += weight;
+    site.totalBytes += weight * size;
+
+    mLiveSamples[ptr] = {size, weight, &site};
+
+    mBytesUntilSample = static_cast<size_t>(mSampleDistribution(mRandom)) + 1;
+}
+
+void ProfilingAllocator::DumpText(std::ostream &out) const {
+
+    std::vector<std::pair<const std::vector<void*>*, const CallSite*>> sites;
+    for (auto &[stack, site] : mCallSites)
+    {
+        sites.push_back({&stack, &site});
+    }
+    std::sort(sites.begin(), sites.end(), [](const auto &a, const auto &b) {
+
+        return a.second->liveBytes > b.second->liveBytes;
+    });
+
+    out << "live bytes, live count, total bytes, total count (estimated from samples every " << mSampleInterval << " bytes)\n";
+    for (auto &[stack, site] : sites)
+    {
+        out << static_cast<size_t>(site->liveBytes) << ", " << static_cast<size_t>(site->liveCount) << ", "
+            << static_cast<size_t>(site->totalBytes) << ", " << static_cast<size_t>(site->totalCount) << '\n';
+
+        char **symbols = backtrace_symbols(stack->data(), static_cast<int>(stack->size()));
+        for (size_t i = 0; i < stack->size(); i++)
+        {
+            out << "    " << (symbols ? symbols[i] : "?") << '\n';
+        }
+        std::free(symbols);
+    }
+}
+
+void ProfilingAllocator::DumpPprof(std::ostream &out) const {
+
+    size_t liveSamples = 0, liveSampleBytes = 0, totalSamples = 0, totalSampleBytes = 0;
+    for (auto &[stack, site] : mCallSites)
+    {
+        liveSamples += site.liveSamples;
+        liveSampleBytes += site.liveSampleBytes;
+        totalSamples += site.totalSamples;
+        totalSampleBytes += site.totalSampleBytes;
+    }
+
+    out << "heap profile: " << liveSamples << ": " << liveSampleBytes << " [" << totalSamples << ": " << totalSampleBytes << "] @ heap_v2/" << mSampleInterval << '\n';
+    for (auto &[stack, site] : mCallSites)
+    {
+        out << site.liveSamples << ": " << site.liveSampleBytes << " [" << site.totalSamples << ": " << site.totalSampleBytes << "] @";
+        for (void *frame : stack)
+        {
+            out << ' ' << frame;
+        }
+        out << '\n';
+    }
+
+    // pprof needs the memory mappings to symbolize the addresses
+    out << "\nMAPPED_LIBRARIES:\n";
+    std::ifstream maps("/proc/self/maps");
+    out << maps.rdbuf();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <iosfwd>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+
+/* @brief Sampling heap profiler implementation of IAllocator, forwarding all calls to another allocator.
+ * 
+ * Samples on average one allocation per sampleInterval allocated bytes, with exponentially distributed gaps so that every byte has the same chance to be sampled.
+ * Records the call stack of sampled allocations and keeps track of sampled objects that are still alive.
+ * Unsampled allocations and frees only cost a subtraction and a lookup in the small table of live samples.
+ * Dumps live and cumulative allocations per call site as flat text or in the legacy pprof heap profile format.
+ * 
+ * @class 
+ */
+class ProfilingAllocator : public IAllocator{
+
+    struct CallSite {
+
+        // Raw number and bytes of samples
+        size_t liveSamples = 0;
+        size_t liveSampleBytes = 0;
+        size_t totalSamples = 0;
+        size_t totalSampleBytes = 0;
+
+        // Estimated number and bytes of all allocations represented by the samples
+        double liveCount = 0.0;
+        double liveBytes = 0.0;
+        double totalCount = 0.0;
+        double totalBytes = 0.0;
+    };
+
+    struct Sample {
+
+        size_t size;
+        double weight;
+        CallSite *site;
+    };
+
+    static constexpr int MaxFrames = 32;
+
+public:
+
+    ProfilingAllocator() = delete;
+
+    /* @brief Constructor that wraps an allocator.
+     *
+     * @param allocator    The allocator to forward all calls to.
+     * @param sampleInterval    Average number of allocated bytes between two samples.
+     */
+    explicit ProfilingAllocator(IAllocator &allocator, const size_t sampleInterval = 512 * 1024);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~ProfilingAllocator();
+    
+    /* @brief Allocates memory from the wrapped allocator and records the call stack if the allocation is sampled.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Allocates zero filled memory from the wrapped allocator and records the call stack if the allocation is sampled.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
+    /* @brief Frees memory in the wrapped allocator and removes it from the live samples.
+     * 
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Clears the wrapped allocator and all live samples.
+     */
+    void  Clear() override;
+
+    bool   Owns(const void* ptr) const override;
+    size_t AllocatedSize(const void* ptr) const override;
+    bool   TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Writes the estimated live and total allocations per call site, sorted by live bytes, with symbolized call stacks.
+     *
+     * @param out    Stream to write to.
+     */
+    void DumpText(std::ostream &out) const;
+
+    /* @brief Writes the raw samples in the legacy pprof heap profile format (heap_v2), followed by the mapped libraries.
+     *
+     * @param out    Stream to write to.
+     */
+    void DumpPprof(std::ostream &out) const;
+
+
+private:
+
+    /* @brief Records the call stack of a sampled allocation and draws the distance to the next sample.
+     *
+     * @param ptr    Pointer to the allocated memory.
+     * @param size    The size of the allocation.
+     */
+    void RecordSample(void* ptr, const size_t size);
+
+
+    IAllocator &mAllocator;
+
+    size_t mSampleInterval;
+    // Remaining bytes to allocate until the next sample
+    size_t mBytesUntilSample;
+    std::mt19937_64 mRandom;
+    std::exponential_distribution<double> mSampleDistribution;
+
+    std::map<std::vector<void*>, CallSite> mCallSites;
+    std::unordered_map<void*, Sample> mLiveSamples;
+};
@@ -0,0 +1,188 @@
+#include "relocatable_allocator.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+RelocatableAllocator::RelocatableAllocator(const size_t totalMemory, IAllocator *parent) :
+    pParent {parent},
+    mFreeHandle {FreeIndex},
+    mTotalMemory {totalMemory},
+    mUsedMemory {0},
+    mMaxUsedMemory {0}
+{
+    assert(totalMemory > 0);
+
+    if (!pParent)
+    {
+        pBase = std::malloc(mTotalMemory);
+    }
+    else
+    {
+        pBase = pParent->Allocate(mTotalMemory, sizeof(max_align_t));
+    }
+
+    mBaseAddress = reinterpret_cast<uintptr_t>(pBase);
+    Clear();
+}
+
+RelocatableAllocator::~RelocatableAllocator() {
+
+    if (!pParent)
+    {
+        std::free(pBase);
+    }
+    else
+    {
+        pParent->Free(pBase);
+    }
+}
+
+RelocatableAllocator::Handle RelocatableAllocator::Allocate(const size_t size) {
+
+    // Keep all blocks aligned, so they stay aligned when moved
+    size_t blockSize = sizeof(BlockHeader) + (size + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+    if (mTopAddress - mBaseAddress + blockSize > mTotalMemory)
+    {
+        if (mUsedMemory + blockSize > mTotalMemory)
+        {
+            throw std::overflow_error("Relocatable allocator is out of memory!");
+        }
+
+        Compact(std::chrono::microseconds::max());
+    }
+
+    // Take handle table entry from free list or append a new one
+    uint32_t index = mFreeHandle;
+    if (index != FreeIndex)
+    {
+        mFreeHandle = mHandles[index].nextFree;
+    }
+    else
+    {
+        index = static_cast<uint32_t>(mHandles.size());
+        mHandles.push_back({0, 1, FreeIndex});
+    }
+
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(mTopAddress);
+    header->size = blockSize;
+    header->index = index;
+
+    HandleEntry &entry = mHandles[index];
+    entry.address = mTopAddress + sizeof(BlockHeader);
+
+    mTopAddress += blockSize;
+    mUsedMemory += blockSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return {index, entry.generation};
+}
+
+void RelocatableAllocator::Free(Handle handle) {
+
+    assert(Resolve(handle) != nullptr);
+
+    HandleEntry &entry = mHandles[handle.index];
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(entry.address - sizeof(BlockHeader));
+    header->index = FreeIndex;
+
+    mUsedMemory -= header->size;
+
+    // Give the top block back directly, unless compaction still has to scan it
+    if (entry.address - sizeof(BlockHeader) + header->size == mTopAddress && !mCompacting)
+    {
+        mTopAddress -= header->size;
+    }
+
+    // Invalidate handle and put entry on the free list, skipping generation 0 on overflow
+    entry.generation = std::max(entry.generation + 1, 1U);
+    entry.nextFree = mFreeHandle;
+    mFreeHandle = handle.index;
+}
+
+void RelocatableAllocator::Clear() {
+
+    mTopAddress = mBaseAddress;
+    mCompacting = false;
+    mScanAddress = mBaseAddress;
+    mCompactAddress = mBaseAddress;
+
+    mFreeHandle = FreeIndex;
+    for (size_t i = mHandles.size(); i > 0; i--)
+    {
+        HandleEntry &entry = mHandles[i - 1];
+        entry.generation = std::max(entry.generation + 1, 1U);
+        entry.nextFree = mFreeHandle;
+        mFreeHandle = static_cast<uint32_t>(i - 1);
+    }
+
+    mUsedMemory = 0;
+}
+
+void* RelocatableAllocator::Resolve(Handle handle) const {
+
+    if (handle.index >= mHandles.size() || mHandles[handle.index].generation != handle.generation)
+    {
+        return nullptr;
+    }
+
+    return reinterpret_cast<void*>(mHandles[handle.index].address);
+}
+
+bool RelocatableAllocator::Compact(const std::chrono::microseconds budget) {
+
+    if (!mCompacting)
+    {
+        if (mUsedMemory == mTopAddress - mBaseAddress)
+        {
+            return true;
+        }
+
+        mCompacting = true;
+        mScanAddress = mBaseAddress;
+        mCompactAddress = mBaseAddress;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    while (mScanAddress < mTopAddress)
+    {
+        CompactStep();
+
+        if (std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start) >= budget)
+        {
+            break;
+        }
+    }
+
+    if (mScanAddress < mTopAddress)
+    {
+        return false;
+    }
+
+    mTopAddress = mCompactAddress;
+    mCompacting = false;
+
+    return true;
+}
+
+void RelocatableAllocator::CompactStep() {
+
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(mScanAddress);
+    size_t blockSize = header->size;
+    uint32_t index = header->index;
+
+    if (index != FreeIndex)
+    {
+        if (mScanAddress != mCompactAddress)
+        {
+            // Ranges may overlap if the gap is smaller than the block
+            std::memmove(reinterpret_cast<void*>(mCompactAddress), header, blockSize);
+            mHandles[index].address = mCompactAddress + sizeof(BlockHeader);
+        }
+
+        mCompactAddress += blockSize;
+    }
+
+    mScanAddress += blockSize;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <chrono>
+#include <vector>
+
+
+/* @brief Handle based allocator for data that tolerates relocation.
+ * 
+ * Allocates new memory from the top of the used memory region and returns generation checked handles instead of pointers.
+ * Handles resolve to the current address of their block through an indirection table.
+ * Frees memory by marking the block as free and invalidating the handle.
+ * Compacts the memory by sliding live blocks down over freed blocks, incrementally within a time budget per call, which removes all external fragmentation.
+ * Clears all allocations by resetting the top of the used memory region and invalidating all handles.
+ * 
+ * Pointers obtained from Resolve() are only valid until the next call to Compact() or Allocate().
+ * 
+ * @class 
+ */
+class RelocatableAllocator {
+
+    struct BlockHeader {
+
+        // Size of the block including the header
+        size_t size;
+        // Index of the handle table entry, FreeIndex if the block was freed
+        uint32_t index;
+        uint32_t padding;
+    };
+
+    struct HandleEntry {
+
+        uintptr_t address;
+        uint32_t generation;
+        uint32_t nextFree;
+    };
+
+    static constexpr uint32_t FreeIndex = UINT32_MAX;
+
+public:
+
+    /* @brief Reference to an allocation, which stays valid while the block is moved by compaction.
+     */
+    struct Handle {
+
+        uint32_t index = 0;
+        // Generation 0 is never used by a live entry, so a default constructed handle never resolves
+        uint32_t generation = 0;
+
+        explicit operator bool() const { return generation != 0;}
+    };
+
+    RelocatableAllocator() = delete;
+
+    /* @brief Constructor that allocates the managed memory portion and calls Clear() to reset the allocator.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes.
+     * @param parent    Optional parent allocator to get memory from.
+     */
+    explicit RelocatableAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
+
+    /* @brief Destructor that frees the managed memory.
+     */
+    ~RelocatableAllocator();
+
+    RelocatableAllocator(const RelocatableAllocator&) = delete;
+    RelocatableAllocator& operator=(const RelocatableAllocator&) = delete;
+
+    /* @brief Allocates a block aligned to alignof(max_align_t) from the top of the used memory region.
+     * If the top is reached but enough memory was freed below, compaction is run to completion first.
+     *  
+     * @param size    The size of the allocated memory section.
+     * 
+     * return Handle to the allocated block.
+     */
+    Handle Allocate(const size_t size);
+
+    /* @brief Frees the block of a handle and invalidates the handle.
+     * 
+     * @param handle    Handle to the block to free.
+     */
+    void  Free(Handle handle);
+
+    /* @brief Frees all blocks and invalidates all handles.
+     */
+    void  Clear();
+
+    /* @brief Returns the current address of the block of a handle.
+     *
+     * @param handle    Handle to resolve.
+     *
+     * @return Pointer to the block, nullptr if the handle was freed.
+     */
+    void* Resolve(Handle handle) const;
+
+    template<typename T>
+    T* Resolve(Handle handle) const { return static_cast<T*>(Resolve(handle));}
+
+    /* @brief Slides live blocks down over freed blocks until compaction is complete or the time budget is used up.
+     * Continues where the previous call stopped.
+     *
+     * @param budget    Maximum time to spend in this call.
+     *
+     * @return True if all freed memory has been reclaimed.
+     */
+    bool Compact(const std::chrono::microseconds budget);
+
+
+    size_t  totalMemory()   const { return mTotalMemory;}
+    size_t  usedMemory()    const { return mUsedMemory;}
+    size_t  maxUsedMemory() const { return mMaxUsedMemory;}
+    // Memory taken by freed blocks not yet reclaimed by compaction
+    size_t  fragmentedMemory() const { return mTopAddress - mBaseAddress - mUsedMemory;}
+
+
+private:
+
+    /* @brief Moves the next block at mScanAddress down to mCompactAddress or skips it if it was freed.
+     */
+    void CompactStep();
+
+
+    // Poiner to a parent allocator, nullptr by default
+    IAllocator *pParent;
+
+    // Pointer to the beginning of the allocated memory
+    void* pBase;
+
+    uintptr_t mBaseAddress;
+    uintptr_t mTopAddress;
+
+    // Compaction moves the block at mScanAddress down to mCompactAddress, all blocks below mCompactAddress are dense
+    bool mCompacting;
+    uintptr_t mScanAddress;
+    uintptr_t mCompactAddress;
+
+    std::vector<HandleEntry> mHandles;
+    uint32_t mFreeHandle;
+
+    size_t mTotalMemory;
+    size_t mUsedMemory;
+    size_t mMaxUsedMemory;
+};
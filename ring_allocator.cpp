@@ -0,0 +1,260 @@
+#include "ring_allocator.h"
+#include <stdexcept>
+
+
+RingAllocator::RingAllocator(const size_t totalMemory, IAllocator *parent) :
+    IAllocator(totalMemory, parent)
+{
+    assert(totalMemory % HeaderSize == 0);
+    // Blocks are placed at multiples of the header size from pBase, so the headers are only aligned if pBase is
+    assert(reinterpret_cast<uintptr_t>(pBase) % HeaderSize == 0);
+
+    Clear();
+}
+
+RingAllocator::~RingAllocator() {
+
+}
+
+void* RingAllocator::Allocate(const size_t size, const size_t align) {
+
+    // Start over at the beginning of the memory if the ring is empty to keep allocations contiguous
+    if (mUsedMemory == 0)
+    {
+        mHead = mTail = 0;
+    }
+
+    size_t blockSize = (HeaderSize + size + HeaderSize - 1) / HeaderSize * HeaderSize;
+    size_t freeSize = mTotalMemory - mUsedMemory;
+    size_t offset = mHead % mTotalMemory;
+    size_t adjustment = BlockAdjustment(offset, align);
+
+    // If the block does not fit in front of the end, skip the rest of the ring and wrap around
+    size_t endSize = mTotalMemory - offset;
+    if (adjustment + blockSize > endSize)
+    {
+        adjustment = BlockAdjustment(0, align);
+        if (endSize + adjustment + blockSize > freeSize)
+        {
+            throw std::overflow_error("Ring allocator is out of memory!");
+        }
+
+        *Header(offset) = {static_cast<offset_t>(endSize), 1};
+        mHead += endSize;
+        mUsedMemory += endSize;
+        offset = 0;
+    }
+    else if (adjustment + blockSize > freeSize)
+    {
+        throw std::overflow_error("Ring allocator is out of memory!");
+    }
+
+    if (adjustment > 0)
+    {
+        *Header(offset) = {static_cast<offset_t>(adjustment), 1};
+    }
+
+    BlockHeader *header = Header(offset + adjustment);
+    *header = {static_cast<offset_t>(blockSize), 0};
+
+    mHead += adjustment + blockSize;
+    mUsedMemory += adjustment + blockSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(header) + HeaderSize);
+}
+
+void RingAllocator::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+    assert(!header->freed);
+    header->freed = 1;
+
+    // Reclaim all freed blocks at the tail, blocks freed out of order are reclaimed once the tail reaches them
+    while (mUsedMemory > 0)
+    {
+        BlockHeader *tail = Header(mTail % mTotalMemory);
+        if (!tail->freed)
+        {
+            break;
+        }
+
+        mTail += tail->size;
+        mUsedMemory -= tail->size;
+    }
+}
+
+void RingAllocator::Clear() {
+
+    mHead = 0;
+    mTail = 0;
+    mUsedMemory = 0;
+}
+
+size_t RingAllocator::AllocatedSize(const void* ptr) const {
+
+    const BlockHeader *header = reinterpret_cast<const BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+
+    return header->size - HeaderSize;
+}
+
+bool RingAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    assert(ptr != nullptr);
+
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+    if (newSize <= header->size - HeaderSize)
+    {
+        return true;
+    }
+
+    // Only the most recent block can grow, and only up to the end of the memory or the tail
+    size_t endOffset = reinterpret_cast<uintptr_t>(header) - reinterpret_cast<uintptr_t>(pBase) + header->size;
+    if (endOffset == mTotalMemory || endOffset != mHead % mTotalMemory)
+    {
+        return false;
+    }
+
+    size_t growSize = (HeaderSize + newSize + HeaderSize - 1) / HeaderSize * HeaderSize - header->size;
+    if (growSize > std::min(mTotalMemory - endOffset, mTotalMemory - mUsedMemory))
+    {
+        return false;
+    }
+
+    header->size += growSize;
+    mHead += growSize;
+    mUsedMemory += growSize;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return true;
+}
+
+size_t RingAllocator::BlockAdjustment(const size_t offset, const size_t align) {
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + offset + HeaderSize;
+    size_t adjustment = getAlignmentAdjustment(address, align);
+
+    // Padding must fit a header to be skipped by the tail, add multiples of align until it does
+    while (adjustment > 0 && adjustment < HeaderSize)
+    {
+        adjustment += align;
+    }
+
+    return adjustment;
+}
+
+
+SpscRingAllocator::SpscRingAllocator(const size_t totalMemory, IAllocator *parent) :
+    IAllocator(totalMemory, parent)
+{
+    assert(totalMemory % HeaderSize == 0);
+    // Blocks are placed at multiples of the header size from pBase, so the headers are only aligned if pBase is
+    assert(reinterpret_cast<uintptr_t>(pBase) % HeaderSize == 0);
+
+    Clear();
+}
+
+SpscRingAllocator::~SpscRingAllocator() {
+
+}
+
+void* SpscRingAllocator::Allocate(const size_t size, const size_t align) {
+
+    // Blocks behind the tail may be reused once the consumer has published the tail
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+    uint64_t tail = mTail.load(std::memory_order_acquire);
+
+    size_t blockSize = (HeaderSize + size + HeaderSize - 1) / HeaderSize * HeaderSize;
+    size_t freeSize = mTotalMemory - (head - tail);
+    size_t offset = head % mTotalMemory;
+    size_t adjustment = BlockAdjustment(offset, align);
+
+    size_t endSize = mTotalMemory - offset;
+    if (adjustment + blockSize > endSize)
+    {
+        adjustment = BlockAdjustment(0, align);
+        if (endSize + adjustment + blockSize > freeSize)
+        {
+            throw std::overflow_error("SPSC ring allocator is out of memory!");
+        }
+
+        *Header(offset) = {static_cast<offset_t>(endSize), 1};
+        head += endSize;
+        offset = 0;
+    }
+    else if (adjustment + blockSize > freeSize)
+    {
+        throw std::overflow_error("SPSC ring allocator is out of memory!");
+    }
+
+    if (adjustment > 0)
+    {
+        *Header(offset) = {static_cast<offset_t>(adjustment), 1};
+    }
+
+    BlockHeader *header = Header(offset + adjustment);
+    *header = {static_cast<offset_t>(blockSize), 0};
+
+    // Publish the headers to the consumer
+    head += adjustment + blockSize;
+    mHead.store(head, std::memory_order_release);
+
+    mUsedMemory = head - tail;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(header) + HeaderSize);
+}
+
+void SpscRingAllocator::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    BlockHeader *header = reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+    assert(!header->freed);
+    header->freed = 1;
+
+    uint64_t tail = mTail.load(std::memory_order_relaxed);
+    uint64_t head = mHead.load(std::memory_order_acquire);
+    while (tail != head)
+    {
+        BlockHeader *tailHeader = Header(tail % mTotalMemory);
+        if (!tailHeader->freed)
+        {
+            break;
+        }
+
+        tail += tailHeader->size;
+    }
+
+    // Hand the reclaimed memory back to the producer
+    mTail.store(tail, std::memory_order_release);
+}
+
+void SpscRingAllocator::Clear() {
+
+    mHead.store(0, std::memory_order_relaxed);
+    mTail.store(0, std::memory_order_relaxed);
+    mUsedMemory = 0;
+}
+
+size_t SpscRingAllocator::AllocatedSize(const void* ptr) const {
+
+    const BlockHeader *header = reinterpret_cast<const BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) - HeaderSize);
+
+    return header->size - HeaderSize;
+}
+
+size_t SpscRingAllocator::BlockAdjustment(const size_t offset, const size_t align) {
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(pBase) + offset + HeaderSize;
+    size_t adjustment = getAlignmentAdjustment(address, align);
+
+    while (adjustment > 0 && adjustment < HeaderSize)
+    {
+        adjustment += align;
+    }
+
+    return adjustment;
+}
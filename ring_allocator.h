@@ -0,0 +1,177 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <atomic>
+
+
+/* @brief Ring buffer implementation of IAllocator for allocations that are freed roughly in allocation order.
+ *
+ * Allocates new memory at the head of the ring, wrapping around to the beginning of the managed memory if the allocation does not fit in front of the end.
+ * Every block starts with a BlockHeader holding its size, alignment padding and the skipped end of the ring are marked as freed blocks.
+ * Frees memory by marking the block as freed, the tail of the ring then advances over all consecutive freed blocks.
+ * Blocks freed out of order therefore keep their memory until all older blocks are freed as well.
+ * Clears all allocations by resetting head and tail.
+ *
+ * usedMemory() includes freed blocks that are not yet reclaimed by the tail.
+ *
+ * @class
+ */
+class RingAllocator : public IAllocator{
+
+    struct BlockHeader {
+
+        // Size of the block including the header
+        offset_t size;
+        // Non-zero once the block was freed
+        offset_t freed;
+    };
+
+    static constexpr size_t HeaderSize = sizeof(BlockHeader);
+
+public:
+
+    RingAllocator() = delete;
+
+    /* @brief Constructor that allocates the managed memory portion and calls Clear() to reset the ring.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes, must be a multiple of the block header size.
+     * @param parent    Optional parent allocator to get memory from, must return memory aligned to the block header size.
+     */
+    explicit RingAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~RingAllocator();
+
+    /* @brief Allocates a properly aligned section of memory at the head of the ring.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Marks the block at ptr as freed and advances the tail over all consecutive freed blocks.
+     *
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Frees all the allocated memory by resetting head and tail to the beginning of the managed memory.
+     */
+    void  Clear() override;
+
+    /* @brief Returns the usable size of an allocated block stored in its BlockHeader.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Grows the most recent allocation in place if the memory behind the head is free.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * @param newSize    The requested new size in bytes.
+     *
+     * @return True if the memory section at ptr now holds at least newSize bytes.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+
+private:
+
+    /* @brief Returns the padding in front of a block at offset so that its memory is aligned, either zero or large enough for a skip header.
+     *
+     * @param offset    Offset of the block from pBase.
+     * @param align    The alignment of the memory section behind the header.
+     */
+    size_t BlockAdjustment(const size_t offset, const size_t align);
+
+    BlockHeader* Header(const size_t offset) const { return reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(pBase) + offset);}
+
+
+    // Positions of head and tail, only ever increase, the offset into the ring is the position modulo mTotalMemory
+    uint64_t mHead;
+    uint64_t mTail;
+};
+
+
+/* @brief Lock-free ring buffer allocator for exactly one producer thread allocating and one consumer thread freeing.
+ *
+ * Works like RingAllocator, but head and tail are atomics owned by the producer and the consumer, so neither side ever waits for the other.
+ * Allocate() must only be called by the producer, Free() only by the consumer, Clear() only while neither is active.
+ * usedMemory() and maxUsedMemory() are updated by the producer and must only be read by it.
+ *
+ * @class
+ */
+class SpscRingAllocator : public IAllocator{
+
+    struct BlockHeader {
+
+        // Size of the block including the header
+        offset_t size;
+        // Non-zero once the block was freed, only written by the consumer after the producer has published the block
+        offset_t freed;
+    };
+
+    static constexpr size_t HeaderSize = sizeof(BlockHeader);
+
+public:
+
+    SpscRingAllocator() = delete;
+
+    /* @brief Constructor that allocates the managed memory portion and calls Clear() to reset the ring.
+     *
+     * @param totalMemory    The size of the managed memory space in bytes, must be a multiple of the block header size.
+     * @param parent    Optional parent allocator to get memory from, must return memory aligned to the block header size.
+     */
+    explicit SpscRingAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~SpscRingAllocator();
+
+    /* @brief Allocates a properly aligned section of memory at the head of the ring, producer only.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Marks the block at ptr as freed and advances the tail over all consecutive freed blocks, consumer only.
+     *
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Frees all the allocated memory by resetting head and tail, neither producer nor consumer may be active.
+     */
+    void  Clear() override;
+
+    /* @brief Returns the usable size of an allocated block stored in its BlockHeader.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+
+private:
+
+    /* @brief Returns the padding in front of a block at offset so that its memory is aligned, either zero or large enough for a skip header.
+     *
+     * @param offset    Offset of the block from pBase.
+     * @param align    The alignment of the memory section behind the header.
+     */
+    size_t BlockAdjustment(const size_t offset, const size_t align);
+
+    BlockHeader* Header(const size_t offset) const { return reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(pBase) + offset);}
+
+
+    // Positions of head and tail on separate cache lines, the producer owns the head and the consumer the tail
+    alignas(64) std::atomic<uint64_t> mHead;
+    alignas(64) std::atomic<uint64_t> mTail;
+};
@@ -0,0 +1,136 @@
+#include "shared_memory_allocator.h"
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+
+
+/* @brief Locks the shared mutex and loads the shared allocator state, stores the state and unlocks on destruction.
+ *
+ * @class
+ */
+class SharedMemoryAllocator::LockGuard {
+
+public:
+
+    explicit LockGuard(SharedMemoryAllocator &allocator) : mAllocator {allocator} {
+
+        Header *header = mAllocator.header();
+
+        // A process died while holding the lock, the state it left is used as is
+        if (pthread_mutex_lock(&header->mutex) == EOWNERDEAD)
+        {
+            pthread_mutex_consistent(&header->mutex);
+        }
+
+        mAllocator.LoadState(header->state);
+    }
+
+    ~LockGuard() {
+
+        Header *header = mAllocator.header();
+        header->state = mAllocator.SaveState();
+        pthread_mutex_unlock(&header->mutex);
+    }
+
+    LockGuard(const LockGuard&) = delete;
+    LockGuard& operator=(const LockGuard&) = delete;
+
+
+private:
+
+    SharedMemoryAllocator &mAllocator;
+};
+
+
+SharedMemoryAllocator::SharedMemoryAllocator(const char *name, const size_t totalMemory) :
+    MappedFile(name, HeaderSize + totalMemory, true),
+    FreeTreeAllocator(static_cast<char*>(data()) + HeaderSize, size() > HeaderSize ? size() - HeaderSize : 0)
+{
+    Header *heapHeader = header();
+
+    if (created())
+    {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&heapHeader->mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+
+        FreeTreeAllocator::Clear();
+        heapHeader->offsetSize = sizeof(offset_t);
+        heapHeader->totalMemory = mTotalMemory;
+        heapHeader->state = SaveState();
+        heapHeader->root = NullOffset;
+        heapHeader->magic.store(Magic, std::memory_order_release);
+        return;
+    }
+
+    if (size() <= HeaderSize || heapHeader->magic.load(std::memory_order_acquire) != Magic)
+    {
+        throw std::runtime_error(std::string(name) + " is not an initialized shared heap.");
+    }
+
+    if (heapHeader->offsetSize != sizeof(offset_t) || heapHeader->totalMemory != mTotalMemory)
+    {
+        throw std::runtime_error(std::string(name) + " does not contain a compatible shared heap.");
+    }
+
+    LockGuard lock(*this);
+}
+
+SharedMemoryAllocator::~SharedMemoryAllocator() {
+
+    FlushPending();
+}
+
+void SharedMemoryAllocator::Unlink(const char *name) {
+
+    shm_unlink(name);
+}
+
+void* SharedMemoryAllocator::Allocate(const size_t size, const size_t align) {
+
+    LockGuard lock(*this);
+    return FreeTreeAllocator::Allocate(size, align);
+}
+
+void SharedMemoryAllocator::Free(void* ptr) {
+
+    LockGuard lock(*this);
+    FreeTreeAllocator::Free(ptr);
+}
+
+void SharedMemoryAllocator::Clear() {
+
+    LockGuard lock(*this);
+    FreeTreeAllocator::Clear();
+}
+
+bool SharedMemoryAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    LockGuard lock(*this);
+    return FreeTreeAllocator::TryExpand(ptr, newSize);
+}
+
+size_t SharedMemoryAllocator::Trim(const bool lazy) {
+
+    LockGuard lock(*this);
+    return FreeTreeAllocator::Trim(lazy);
+}
+
+void SharedMemoryAllocator::FlushPending() {
+
+    LockGuard lock(*this);
+    FreeTreeAllocator::FlushPending();
+}
+
+void SharedMemoryAllocator::SetRoot(void* ptr) {
+
+    // Other processes only see the managed memory, direct mappings are accepted by Owns() but private to this process
+    assert(ptr == nullptr || IAllocator::Owns(ptr));
+
+    LockGuard lock(*this);
+    header()->root = ToOffset(ptr);
+}
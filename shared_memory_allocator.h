@@ -0,0 +1,110 @@
+#pragma once
+
+
+#include "free_tree_allocator.h"
+#include "virtual_memory.h"
+
+#include <atomic>
+#include <pthread.h>
+
+
+/* @brief FreeTreeAllocator in POSIX shared memory, so several processes can allocate from one heap and exchange objects without copying.
+ * 
+ * The first process creates and initializes the shared memory object, all others open it, possibly at a different address.
+ * All allocator metadata is stored as offsets from pBase, the shared header keeps the allocator state, a process-shared robust mutex and the offset of one root object.
+ * Every operation locks the mutex, loads the shared state, runs the FreeTreeAllocator operation and stores the state back.
+ * Objects must be passed between processes as offsets, see OffsetOf() and PointerAt().
+ * usedMemory() reflects the shared state as of the last operation of this process.
+ * 
+ * @class 
+ */
+class SharedMemoryAllocator : private MappedFile, public FreeTreeAllocator{
+
+    struct Header {
+
+        // Written last by the creating process, once the heap is initialized
+        std::atomic<uint64_t> magic;
+        uint64_t offsetSize;
+        uint64_t totalMemory;
+        pthread_mutex_t mutex;
+        State state;
+        offset_t root;
+    };
+
+    // Size reserved for the header in front of the managed memory, keeps the managed memory cache line aligned
+    static constexpr size_t HeaderSize = 128;
+    static_assert(sizeof(Header) <= HeaderSize, "Shared heap header does not fit.");
+
+    class LockGuard;
+
+public:
+
+    SharedMemoryAllocator() = delete;
+
+    /* @brief Constructor that opens the shared heap with the given name, or creates and initializes it if it does not exist.
+     * Throws std::runtime_error if the shared memory object is not initialized yet or was not created by a compatible allocator.
+     *
+     * @param name    Name of the shared memory object, starting with a slash.
+     * @param totalMemory    The size of the managed memory space in bytes of a new heap, ignored when opening an existing heap.
+     */
+    SharedMemoryAllocator(const char *name, const size_t totalMemory);
+
+    /* @brief Destructor that flushes pending frees and unmaps the shared memory, which stays available to other processes until Unlink() is called.
+     */
+    ~SharedMemoryAllocator();
+
+    /* @brief Removes the name of a shared heap, its memory is released once all processes have unmapped it.
+     *
+     * @param name    Name of the shared memory object.
+     */
+    static void Unlink(const char *name);
+
+    void* Allocate(const size_t size, const size_t align = 1) override;
+    void  Free(void* ptr) override;
+    void  Clear() override;
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Gives the pages inside all free regions back to the operating system while holding the lock.
+     *
+     * @param lazy    Let the operating system reclaim the pages only under memory pressure (MADV_FREE).
+     * 
+     * @return The number of bytes given back.
+     */
+    size_t Trim(const bool lazy = false);
+
+    /* @brief Coalesces the blocks freed by this process but not yet returned to the shared heap while holding the lock.
+     */
+    void FlushPending();
+
+    /* @brief Sets the root object, which other processes can use as entry point to the shared data.
+     *
+     * @param ptr    Pointer to the root object in the heap, or nullptr.
+     */
+    void SetRoot(void* ptr);
+
+    /* @brief Returns the root object set with SetRoot() by any process, or nullptr.
+     */
+    template<typename T = void>
+    T* Root() const { return FromOffset<T>(header()->root);}
+
+    /* @brief Converts a pointer into the heap to an offset that is valid in all processes.
+     *
+     * @param ptr    Pointer into the heap or nullptr.
+     */
+    offset_t OffsetOf(const void* ptr) const { return ToOffset(ptr);}
+
+    /* @brief Converts an offset returned by OffsetOf() in any process to a pointer into the heap as mapped in this process.
+     *
+     * @param offset    Offset into the heap.
+     */
+    template<typename T = void>
+    T* PointerAt(const offset_t offset) const { return FromOffset<T>(offset);}
+
+
+private:
+
+    Header* header() const { return static_cast<Header*>(data());}
+
+
+    static constexpr uint64_t Magic = 0x53484152'45484541;
+};
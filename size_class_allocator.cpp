@@ -0,0 +1,343 @@
+#include "size_class_allocator.h"
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace {
+
+    size_t RoundUp(const size_t value, const size_t multiple) {
+
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    // Bytes the fallback needs for the request padded to its minimum block size, its allocation header and worst case alignment padding
+    size_t FallbackSize(const SizeStats &stats) {
+
+        return RoundUp(std::max(stats.size, FreeTreeAllocator::MinAllocationSize), sizeof(void*)) + 2 * sizeof(offset_t) + stats.align - 1;
+    }
+}
+
+
+SizeClassConfig SizeClassConfig::Plan(const std::vector<SizeStats> &stats, const SizeClassPlanOptions &options) {
+
+    assert(options.maxClasses > 0);
+
+    // Merge repeated sizes, the rest goes to the fallback
+    std::map<size_t, SizeStats> poolSizes;
+    double fallbackBytes = 0.0;
+    for (const SizeStats &s : stats)
+    {
+        if (s.size == 0 || s.peakCount == 0)
+        {
+            continue;
+        }
+
+        if (s.size > options.maxPoolSize || s.align > PoolAlignment)
+        {
+            fallbackBytes += static_cast<double>(s.peakCount) * FallbackSize(s);
+            continue;
+        }
+
+        auto [pos, inserted] = poolSizes.insert({s.size, s});
+        if (!inserted)
+        {
+            pos->second.align = std::max(pos->second.align, s.align);
+            pos->second.peakCount += s.peakCount;
+            pos->second.totalCount += s.totalCount;
+        }
+    }
+
+    std::vector<SizeStats> sizes;
+    for (auto &[size, s] : poolSizes)
+    {
+        sizes.push_back(s);
+    }
+
+    size_t n = sizes.size();
+    size_t maxClasses = std::min(options.maxClasses, n);
+
+    // Prefix sums of peak counts and peak bytes, so the waste of a class is chunkSize * count - bytes
+    std::vector<double> peakCounts(n + 1, 0.0), peakBytes(n + 1, 0.0);
+    for (size_t i = 0; i < n; i++)
+    {
+        peakCounts[i + 1] = peakCounts[i] + sizes[i].peakCount;
+        peakBytes[i + 1] = peakBytes[i] + static_cast<double>(sizes[i].peakCount) * sizes[i].size;
+    }
+
+    // Chunks hold a free list link and are a multiple of the largest alignment of their sizes
+    auto chunkSize = [&](const size_t last, const size_t align) {
+
+        return RoundUp(std::max(sizes[last].size, sizeof(void*)), std::max(align, sizeof(void*)));
+    };
+
+    // cost[k][j]: least waste of covering the first j sizes with k classes, start[k][j]: first size of the last of those classes
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> cost(maxClasses + 1, std::vector<double>(n + 1, infinity));
+    std::vector<std::vector<size_t>> start(maxClasses + 1, std::vector<size_t>(n + 1, 0));
+    cost[0][0] = 0.0;
+
+    for (size_t k = 1; k <= maxClasses; k++)
+    {
+        for (size_t j = 1; j <= n; j++)
+        {
+            // The last class holds sizes i to j - 1, walking i down collects their largest alignment on the way
+            size_t align = 1;
+            for (size_t i = j; i-- > k - 1;)
+            {
+                align = std::max(align, sizes[i].align);
+                if (cost[k - 1][i] == infinity)
+                {
+                    continue;
+                }
+
+                double waste = static_cast<double>(chunkSize(j - 1, align)) * (peakCounts[j] - peakCounts[i]) - (peakBytes[j] - peakBytes[i]);
+                double total = cost[k - 1][i] + waste + options.classCost;
+                if (total < cost[k][j])
+                {
+                    cost[k][j] = total;
+                    start[k][j] = i;
+                }
+            }
+        }
+    }
+
+    size_t bestClasses = 0;
+    for (size_t k = 1; k <= maxClasses; k++)
+    {
+        if (bestClasses == 0 || cost[k][n] < cost[bestClasses][n])
+        {
+            bestClasses = k;
+        }
+    }
+
+    SizeClassConfig config;
+    for (size_t k = bestClasses, j = n; k > 0; j = start[k][j], k--)
+    {
+        size_t i = start[k][j];
+        size_t align = 1;
+        for (size_t m = i; m < j; m++)
+        {
+            align = std::max(align, sizes[m].align);
+        }
+        size_t chunk = chunkSize(j - 1, align);
+        size_t chunks = static_cast<size_t>(std::ceil((peakCounts[j] - peakCounts[i]) * options.headroom));
+        // Sizes rounded up to the same chunk size by their alignment share one pool
+        if (!config.classes.empty() && config.classes.back().chunkSize == chunk)
+        {
+            config.classes.back().totalMemory += chunks * chunk;
+            continue;
+        }
+        config.classes.push_back({chunk, std::max(chunks, size_t{1}) * chunk});
+    }
+    std::reverse(config.classes.begin(), config.classes.end());
+
+    config.fallbackMemory = RoundUp(static_cast<size_t>(fallbackBytes * options.headroom), 4096) + 64 * 1024;
+
+    return config;
+}
+
+SizeClassConfig SizeClassConfig::Load(std::istream &in) {
+
+    SizeClassConfig config;
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key) || key[0] == '#')
+        {
+            continue;
+        }
+
+        if (key == "class")
+        {
+            SizeClass sizeClass;
+            if (!(fields >> sizeClass.chunkSize >> sizeClass.totalMemory) || sizeClass.chunkSize == 0 || sizeClass.totalMemory % sizeClass.chunkSize != 0)
+            {
+                throw std::runtime_error("Invalid size class: " + line);
+            }
+            config.classes.push_back(sizeClass);
+        }
+        else if (key == "fallback")
+        {
+            if (!(fields >> config.fallbackMemory))
+            {
+                throw std::runtime_error("Invalid fallback size: " + line);
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Unknown size class configuration entry: " + line);
+        }
+    }
+
+    std::sort(config.classes.begin(), config.classes.end(), [](const SizeClass &a, const SizeClass &b) {
+
+        return a.chunkSize < b.chunkSize;
+    });
+
+    return config;
+}
+
+void SizeClassConfig::Save(std::ostream &out) const {
+
+    out << "# class <chunkSize> <totalMemory>\n";
+    for (const SizeClass &sizeClass : classes)
+    {
+        out << "class " << sizeClass.chunkSize << ' ' << sizeClass.totalMemory << '\n';
+    }
+    out << "fallback " << fallbackMemory << '\n';
+}
+
+void SizeClassConfig::WriteHeader(std::ostream &out, const std::string &name) const {
+
+    out << "// Generated by size_class_tool, do not edit.\n";
+    out << "#pragma once\n\n\n";
+    out << "#include \"size_class_allocator.h\"\n\n\n";
+    out << "inline const SizeClassConfig " << name << " = {\n";
+    out << "    {\n";
+    for (const SizeClass &sizeClass : classes)
+    {
+        out << "        {" << sizeClass.chunkSize << ", " << sizeClass.totalMemory << "},\n";
+    }
+    out << "    },\n";
+    out << "    " << fallbackMemory << '\n';
+    out << "};\n";
+}
+
+
+SizeClassAllocator::SizeClassAllocator(const SizeClassConfig &config) :
+    IAllocator(nullptr, config.fallbackMemory),
+    mPoolMisses {0}
+{
+    for (const SizeClassConfig::SizeClass &sizeClass : config.classes)
+    {
+        assert(mChunkSizes.empty() || mChunkSizes.back() < sizeClass.chunkSize);
+
+        mChunkSizes.push_back(sizeClass.chunkSize);
+        mPools.push_back(std::make_unique<PoolAllocator>(sizeClass.totalMemory, sizeClass.chunkSize));
+        mTotalMemory += sizeClass.totalMemory;
+    }
+
+    if (config.fallbackMemory > 0)
+    {
+        mFallback = std::make_unique<FreeTreeAllocator>(config.fallbackMemory);
+    }
+}
+
+SizeClassAllocator::~SizeClassAllocator() {
+
+}
+
+void* SizeClassAllocator::Allocate(const size_t size, const size_t align) {
+
+    void *mem = nullptr;
+
+    size_t i = std::lower_bound(mChunkSizes.begin(), mChunkSizes.end(), size) - mChunkSizes.begin();
+    if (i < mChunkSizes.size() && align <= SizeClassConfig::PoolAlignment && mChunkSizes[i] % align == 0)
+    {
+        PoolAllocator &pool = *mPools[i];
+        if (pool.usedMemory() + mChunkSizes[i] <= pool.totalMemory())
+        {
+            mem = pool.Allocate(size, align);
+            mUsedMemory += mChunkSizes[i];
+        }
+        else
+        {
+            mPoolMisses++;
+        }
+    }
+
+    if (mem == nullptr)
+    {
+        if (!mFallback)
+        {
+            throw std::overflow_error("Size class allocator has no pool or fallback for the allocation.");
+        }
+
+        size_t fallbackUsed = mFallback->usedMemory();
+        mem = mFallback->Allocate(size, align);
+        mUsedMemory += mFallback->usedMemory() - fallbackUsed;
+    }
+
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return mem;
+}
+
+void SizeClassAllocator::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    PoolAllocator *pool = FindPool(ptr);
+    if (pool)
+    {
+        pool->Free(ptr);
+        mUsedMemory -= pool->AllocatedSize(ptr);
+        return;
+    }
+
+    if (!mFallback)
+    {
+        throw std::invalid_argument("Pointer is not owned by any pool of the size class allocator.");
+    }
+
+    size_t fallbackUsed = mFallback->usedMemory();
+    mFallback->Free(ptr);
+    mUsedMemory -= fallbackUsed - mFallback->usedMemory();
+}
+
+void SizeClassAllocator::Clear() {
+
+    for (auto &pool : mPools)
+    {
+        pool->Clear();
+    }
+    if (mFallback)
+    {
+        mFallback->Clear();
+    }
+
+    mUsedMemory = 0;
+}
+
+bool SizeClassAllocator::Owns(const void* ptr) const {
+
+    return FindPool(ptr) != nullptr || (mFallback && mFallback->Owns(ptr));
+}
+
+size_t SizeClassAllocator::AllocatedSize(const void* ptr) const {
+
+    PoolAllocator *pool = FindPool(ptr);
+    if (pool)
+    {
+        return pool->AllocatedSize(ptr);
+    }
+
+    if (!mFallback)
+    {
+        throw std::invalid_argument("Pointer is not owned by any pool of the size class allocator.");
+    }
+
+    return mFallback->AllocatedSize(ptr);
+}
+
+PoolAllocator* SizeClassAllocator::FindPool(const void* ptr) const {
+
+    for (auto &pool : mPools)
+    {
+        if (pool->Owns(ptr))
+        {
+            return pool.get();
+        }
+    }
+
+    return nullptr;
+}
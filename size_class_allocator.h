@@ -0,0 +1,155 @@
+#pragma once
+
+
+#include "allocator.h"
+#include "free_tree_allocator.h"
+#include "pool_allocator.h"
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/* @brief Allocation statistics of one request size, as recorded from a trace or collected by the application.
+ */
+struct SizeStats {
+
+    size_t size;
+    // Largest alignment requested for this size
+    size_t align;
+    // Maximum number of allocations of this size alive at the same time
+    size_t peakCount;
+    size_t totalCount;
+};
+
+
+/* @brief Options of SizeClassConfig::Plan().
+ */
+struct SizeClassPlanOptions {
+
+    // Larger sizes and alignments above PoolAlignment are left to the fallback FreeTreeAllocator
+    size_t maxPoolSize = 1024;
+    size_t maxClasses = 16;
+    // Bytes a class has to save to be worth a pool of its own, covers the unused end of the pool and a cold free list
+    size_t classCost = 4096;
+    // Factor applied to the peak memory of every pool and the fallback
+    double headroom = 1.25;
+};
+
+
+/* @brief Pools and fallback size of a SizeClassAllocator, planned from allocation statistics and stored as config file or generated header.
+ */
+struct SizeClassConfig {
+
+    struct SizeClass {
+
+        size_t chunkSize;
+        size_t totalMemory;
+    };
+
+    // Alignment guaranteed by pool chunks, PoolAllocators get their memory from calloc
+    static constexpr size_t PoolAlignment = alignof(std::max_align_t);
+
+    // Sorted by chunk size
+    std::vector<SizeClass> classes;
+    size_t fallbackMemory = 0;
+
+    /* @brief Chooses the size classes that minimize the memory wasted at peak by rounding sizes up to chunk sizes, plus classCost per class.
+     * Solved exactly by dynamic programming over the distinct sizes, every class ends at one of the recorded sizes.
+     * Pools are sized for the sum of the peaks of their sizes, the fallback for the peaks of all other sizes including headers.
+     *
+     * @param stats    Statistics per request size, in any order, sizes may repeat.
+     * @param options    Limits and cost model of the plan.
+     *
+     * @return The planned configuration.
+     */
+    static SizeClassConfig Plan(const std::vector<SizeStats> &stats, const SizeClassPlanOptions &options = {});
+
+    /* @brief Reads a configuration written by Save(), throws std::runtime_error on malformed lines.
+     *
+     * @param in    Stream to read from.
+     */
+    static SizeClassConfig Load(std::istream &in);
+
+    /* @brief Writes the configuration as text, one "class <chunkSize> <totalMemory>" line per pool and a "fallback <totalMemory>" line.
+     *
+     * @param out    Stream to write to.
+     */
+    void Save(std::ostream &out) const;
+
+    /* @brief Writes a header defining the configuration as an inline constant.
+     *
+     * @param out    Stream to write to.
+     * @param name    Name of the constant.
+     */
+    void WriteHeader(std::ostream &out, const std::string &name) const;
+};
+
+
+/* @brief Segregating implementation of IAllocator with size classes chosen at run time from a SizeClassConfig.
+ *
+ * Allocates from the PoolAllocator of the smallest size class that fits the request, falls back to a FreeTreeAllocator
+ * for larger requests, stricter alignments and full pools. Frees memory with the pool or fallback that owns it.
+ * Clears all allocations by clearing all pools and the fallback.
+ *
+ * @class
+ */
+class SizeClassAllocator : public IAllocator{
+
+public:
+
+    SizeClassAllocator() = delete;
+
+    /* @brief Constructor that creates one PoolAllocator per size class and the fallback FreeTreeAllocator.
+     *
+     * @param config    Size classes and fallback size, e.g. loaded with SizeClassConfig::Load() or from a generated header.
+     */
+    explicit SizeClassAllocator(const SizeClassConfig &config);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~SizeClassAllocator();
+
+    /* @brief Allocates a properly aligned section of memory from the smallest fitting pool or the fallback.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Frees the allocated memory section at ptr in the pool or fallback owning it.
+     *
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Frees all the allocated memory of all pools and the fallback.
+     */
+    void  Clear() override;
+
+    bool   Owns(const void* ptr) const override;
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Returns the number of allocations served by the fallback because their pool was full.
+     */
+    size_t poolMisses() const { return mPoolMisses;}
+
+
+private:
+
+    /* @brief Returns the pool owning ptr, nullptr if it belongs to the fallback.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    PoolAllocator* FindPool(const void* ptr) const;
+
+
+    std::vector<size_t> mChunkSizes;
+    std::vector<std::unique_ptr<PoolAllocator>> mPools;
+    std::unique_ptr<FreeTreeAllocator> mFallback;
+
+    size_t mPoolMisses;
+};
@@ -0,0 +1,258 @@
+/* Plans the size classes of a SizeClassAllocator from an allocation trace or statistics and writes them as config file or header.
+ *
+ * Input lines, '#' starts a comment:
+ *     a <id> <size> [align]                  allocation of size bytes, identified by id until it is freed
+ *     f <id>                                 free of the allocation with id
+ *     s <size> <align> <peak> <total>        statistics of one request size
+ *
+ * A trace is replayed against the planned allocator and the fallback grown until the replay succeeds, as the sum of peaks ignores fragmentation.
+ * Statistics lines cannot be replayed, their fallback size stays an estimate.
+ *
+ * Only compiled with SIZE_CLASS_TOOL defined, so building all sources into the test program keeps a single main, see README.md.
+ */
+#if defined(SIZE_CLASS_TOOL)
+
+#include "size_class_allocator.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+
+namespace {
+
+    struct LiveStats {
+
+        size_t live = 0;
+        size_t peak = 0;
+        size_t total = 0;
+    };
+
+    // One allocation or free of a trace, size is zero for frees
+    struct TraceOp {
+
+        uint64_t id;
+        size_t size;
+        size_t align;
+    };
+
+    /* @brief Replays a trace and collects the peak number of live allocations per size and alignment, statistics lines are taken as they are.
+     *
+     * @param in    Stream to read the trace from.
+     * @param trace    Receives the allocations and frees of the trace in order.
+     *
+     * @return Statistics per request size and alignment.
+     */
+    std::vector<SizeStats> ReadStats(std::istream &in, std::vector<TraceOp> &trace) {
+
+        std::map<std::pair<size_t, size_t>, LiveStats> sizes;
+        std::unordered_map<uint64_t, std::pair<size_t, size_t>> liveAllocations;
+        std::vector<SizeStats> stats;
+
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(in, line))
+        {
+            ++lineNumber;
+
+            std::istringstream fields(line);
+            std::string op;
+            if (!(fields >> op) || op[0] == '#')
+            {
+                continue;
+            }
+
+            bool valid = false;
+            if (op == "a")
+            {
+                uint64_t id;
+                size_t size, align = 1;
+                valid = static_cast<bool>(fields >> id >> size);
+                fields >> align;
+                if (valid)
+                {
+                    LiveStats &live = sizes[{size, align}];
+                    live.peak = std::max(live.peak, ++live.live);
+                    live.total++;
+                    liveAllocations[id] = {size, align};
+                    trace.push_back({id, size, align});
+                }
+            }
+            else if (op == "f")
+            {
+                uint64_t id;
+                valid = static_cast<bool>(fields >> id);
+                auto pos = valid ? liveAllocations.find(id) : liveAllocations.end();
+                if (pos != liveAllocations.end())
+                {
+                    sizes[pos->second].live--;
+                    liveAllocations.erase(pos);
+                    trace.push_back({id, 0, 0});
+                }
+            }
+            else if (op == "s")
+            {
+                SizeStats s;
+                valid = static_cast<bool>(fields >> s.size >> s.align >> s.peakCount >> s.totalCount);
+                if (valid)
+                {
+                    stats.push_back(s);
+                }
+            }
+
+            if (!valid)
+            {
+                std::cerr << "Skipping invalid line " << lineNumber << ": " << line << '\n';
+            }
+        }
+
+        for (auto &[key, live] : sizes)
+        {
+            stats.push_back({key.first, key.second, live.peak, live.total});
+        }
+
+        return stats;
+    }
+
+    /* @brief Replays a trace against a SizeClassAllocator built from config.
+     *
+     * @param config    The configuration to check.
+     * @param trace    Allocations and frees to replay.
+     *
+     * @return False if an allocation failed.
+     */
+    bool Replay(const SizeClassConfig &config, const std::vector<TraceOp> &trace) {
+
+        SizeClassAllocator alloc(config);
+        std::unordered_map<uint64_t, void*> ptrs;
+
+        try
+        {
+            for (const TraceOp &op : trace)
+            {
+                if (op.size > 0)
+                {
+                    ptrs[op.id] = alloc.Allocate(op.size, op.align);
+                }
+                else
+                {
+                    auto pos = ptrs.find(op.id);
+                    alloc.Free(pos->second);
+                    ptrs.erase(pos);
+                }
+            }
+        }
+        catch (const std::overflow_error&)
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    void PrintUsage() {
+
+        std::cerr << "usage: size_class_tool <trace|-> [--header <name>] [--max-pool-size <bytes>] [--max-classes <n>] [--class-cost <bytes>] [--headroom <factor>]\n";
+    }
+}
+
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string headerName;
+    SizeClassPlanOptions options;
+
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--header")
+        {
+            headerName = value;
+        }
+        else if (option == "--max-pool-size")
+        {
+            options.maxPoolSize = std::stoull(value);
+        }
+        else if (option == "--max-classes")
+        {
+            options.maxClasses = std::stoull(value);
+        }
+        else if (option == "--class-cost")
+        {
+            options.classCost = std::stoull(value);
+        }
+        else if (option == "--headroom")
+        {
+            options.headroom = std::stod(value);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    std::vector<SizeStats> stats;
+    std::vector<TraceOp> trace;
+    if (input == "-")
+    {
+        stats = ReadStats(std::cin, trace);
+    }
+    else
+    {
+        std::ifstream file(input);
+        if (!file)
+        {
+            std::cerr << "Could not open " << input << '\n';
+            return 1;
+        }
+        stats = ReadStats(file, trace);
+    }
+
+    SizeClassConfig config = SizeClassConfig::Plan(stats, options);
+
+    // Holes between long-lived blocks can make the fallback fail below its planned size, grow it until the trace fits
+    size_t replays = 0;
+    while (!trace.empty() && !Replay(config, trace))
+    {
+        if (++replays == 64)
+        {
+            std::cerr << "Trace does not fit into a fallback of " << config.fallbackMemory << " bytes\n";
+            return 1;
+        }
+        config.fallbackMemory = (config.fallbackMemory + config.fallbackMemory / 4 + 4095) / 4096 * 4096;
+    }
+
+    if (headerName.empty())
+    {
+        config.Save(std::cout);
+    }
+    else
+    {
+        config.WriteHeader(std::cout, headerName);
+    }
+
+    size_t poolMemory = 0;
+    for (const SizeClassConfig::SizeClass &sizeClass : config.classes)
+    {
+        poolMemory += sizeClass.totalMemory;
+    }
+    std::cerr << stats.size() << " sizes, " << config.classes.size() << " size classes with " << poolMemory << " bytes, fallback " << config.fallbackMemory << " bytes\n";
+
+    return 0;
+}
+
+#endif
@@ -4,14 +4,40 @@
 
 
 StackAllocator::StackAllocator(const size_t totalMemory, IAllocator *parent) :
-    IAllocator(totalMemory, parent)
+    IAllocator(totalMemory, parent),
+    mReserved {false},
+    mRetainedMemory {totalMemory}
 {
     mBaseAddress = reinterpret_cast<uintptr_t>(pBase);
+    mZeroedAddress = mZeroedMemory ? mBaseAddress : mBaseAddress + mTotalMemory;
+    mCommittedAddress = mBaseAddress + mTotalMemory;
+    Clear();
+}
+
+StackAllocator::StackAllocator(const size_t totalMemory, const VirtualReserve reserve) :
+    IAllocator(VirtualMemory::ReservePages(totalMemory), totalMemory),
+    mReserved {true},
+    mRetainedMemory {reserve.retainedMemory}
+{
+    if (pBase == nullptr)
+    {
+        throw std::overflow_error("Stack allocator could not reserve the address range!");
+    }
+
+    // Committed pages start out as zero
+    mZeroedMemory = true;
+    mBaseAddress = reinterpret_cast<uintptr_t>(pBase);
+    mZeroedAddress = mBaseAddress;
+    mCommittedAddress = mBaseAddress;
     Clear();
 }
 
 StackAllocator::~StackAllocator() {
 
+    if (mReserved)
+    {
+        VirtualMemory::UnmapPages(pBase, mTotalMemory);
+    }
 }
 
 void* StackAllocator::Allocate(const size_t size, const size_t align) {
@@ -24,13 +50,35 @@ void* StackAllocator::Allocate(const size_t size, const size_t align) {
         throw std::overflow_error("Stack allocator is out of memory!");
     }
 
+    if (alignedAddress + size > mCommittedAddress && !Commit(alignedAddress + size))
+    {
+        throw std::overflow_error("Stack allocator could not commit memory!");
+    }
+
     mTopAddress = alignedAddress + size;
+    mLastAddress = alignedAddress;
+    mZeroedAddress = std::max(mZeroedAddress, mTopAddress);
     mUsedMemory = mTopAddress - mBaseAddress;
     mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
 
     return reinterpret_cast<void*>(alignedAddress);
 }
 
+void* StackAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    uintptr_t zeroedAddress = mZeroedAddress;
+    void *mem = Allocate(size, align);
+
+    // Only memory below the old zeroed address may have been used before
+    uintptr_t address = reinterpret_cast<uintptr_t>(mem);
+    if (address < zeroedAddress)
+    {
+        ZeroMemory(mem, std::min(size, zeroedAddress - address));
+    }
+
+    return mem;
+}
+
 void StackAllocator::Free(void* ptr) {
 
     assert(ptr != nullptr);
@@ -44,11 +92,89 @@ void StackAllocator::Free(void* ptr) {
     }
 
     mTopAddress = newTopAddress;
+    mLastAddress = 0;
     mUsedMemory = mTopAddress - mBaseAddress;
 }
 
 void StackAllocator::Clear() {
 
     mTopAddress = mBaseAddress;
+    mLastAddress = 0;
     mUsedMemory = 0;
-}
\ No newline at end of file
+
+    if (!mReserved)
+    {
+        return;
+    }
+
+    size_t pageSize = VirtualMemory::PageSize();
+    uintptr_t retainedAddress = mBaseAddress + std::min((mRetainedMemory + pageSize - 1) & ~(pageSize - 1), mTotalMemory);
+    if (mCommittedAddress > retainedAddress)
+    {
+        VirtualMemory::DecommitPages(reinterpret_cast<void*>(retainedAddress), mCommittedAddress - retainedAddress);
+        mCommittedAddress = retainedAddress;
+        // Decommitted pages read as zero once they are committed again
+        mZeroedAddress = std::min(mZeroedAddress, retainedAddress);
+    }
+}
+
+size_t StackAllocator::AllocatedSize(const void* ptr) const {
+
+    return mTopAddress - reinterpret_cast<uintptr_t>(ptr);
+}
+
+bool StackAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    if (address != mLastAddress || address - mBaseAddress + newSize > mTotalMemory)
+    {
+        return false;
+    }
+
+    if (address + newSize > mCommittedAddress && !Commit(address + newSize))
+    {
+        return false;
+    }
+
+    mTopAddress = address + newSize;
+    mZeroedAddress = std::max(mZeroedAddress, mTopAddress);
+    mUsedMemory = mTopAddress - mBaseAddress;
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return true;
+}
+
+void* StackAllocator::Reallocate(void* ptr, const size_t newSize, const size_t align) {
+
+    if (!ptr)
+    {
+        return Allocate(newSize, align);
+    }
+
+    if ((reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0 && TryExpand(ptr, newSize))
+    {
+        return ptr;
+    }
+
+    size_t oldSize = AllocatedSize(ptr);
+    void *mem = Allocate(newSize, align);
+    std::memcpy(mem, ptr, std::min(oldSize, newSize));
+
+    return mem;
+}
+
+bool StackAllocator::Commit(const uintptr_t address) {
+
+    size_t granularity = std::max(CommitGranularity, VirtualMemory::PageSize());
+    uintptr_t endAddress = std::min((address + granularity - 1) & ~(granularity - 1), mBaseAddress + mTotalMemory);
+    endAddress = (endAddress + VirtualMemory::PageSize() - 1) & ~(VirtualMemory::PageSize() - 1);
+
+    if (!VirtualMemory::CommitPages(reinterpret_cast<void*>(mCommittedAddress), endAddress - mCommittedAddress))
+    {
+        return false;
+    }
+
+    mCommittedAddress = endAddress;
+
+    return true;
+}
@@ -2,6 +2,7 @@
 
 
 #include "allocator.h"
+#include "virtual_memory.h"
 
 
 /* @brief Stack implementation of IAllocator.
@@ -9,6 +10,8 @@
  * Allocates new memory from mTopAddress of the used memory region.
  * Frees memory by moving mTopAddress of the used memory region down to a specific address, freeing all allocated memory above.
  * Clears all allocations by setting mTopAddress to mBaseAddress of the managed memory space.
+ * With VirtualReserve the managed memory is only a reserved address range, pages are committed as the top advances
+ * and Clear() gives everything above the retained memory back to the operating system, so the stack can grow far without relocating.
  * 
  * @class 
  */
@@ -25,7 +28,14 @@ public:
      */
     explicit StackAllocator(const size_t totalMemory, IAllocator *parent = nullptr);
 
-    /* @brief Default destructor that does nothing.
+    /* @brief Constructor that reserves the managed memory portion as virtual address range without committing it and calls Clear() to reset the stack.
+     *
+     * @param totalMemory    The size of the reserved address range in bytes, may be larger than physical memory.
+     * @param reserve    Amount of memory that stays committed on Clear().
+     */
+    StackAllocator(const size_t totalMemory, const VirtualReserve reserve);
+
+    /* @brief Destructor that releases a reserved address range, memory from calloc or a parent is freed by IAllocator.
      */
     ~StackAllocator();
     
@@ -38,19 +48,80 @@ public:
      */
     void* Allocate(const size_t size, const size_t align = 1) override;
 
+    /* @brief Allocates a zero filled section of memory from the top of the stack, clearing only memory that was used since construction.
+     *  
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * 
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
     /* @brief Frees all the allocated memory from the top of the stack down to a given position.
      * 
      * @param ptr    Pointer to the memory position to free.
      */
     void  Free(void* ptr) override;
 
-    /* @brief Frees all the allocated memory of the stack.
+    /* @brief Frees all the allocated memory of the stack, with VirtualReserve also decommits all pages above the retained memory.
      */
     void  Clear() override;
 
+    /* @brief Returns the distance from ptr to the top of the stack, which is the exact size for the last allocation.
+     * The stack keeps no sizes, for any other allocation this is an upper bound that includes all allocations above it.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    size_t AllocatedSize(const void* ptr) const override;
+
+    /* @brief Grows or shrinks the last allocation by moving the top of the stack.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     * @param newSize    The requested new size in bytes.
+     * 
+     * @return True if ptr is the last allocation and the new size fits into the managed memory.
+     */
+    bool  TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Resizes the last allocation in place, any other allocation is copied to the top of the stack.
+     * The old memory section is not freed, since that would free everything above it.
+     * As AllocatedSize() is only an upper bound for those, the tail of the new section may hold copies of the allocations above the old one.
+     *
+     * @param ptr    Pointer to the allocated memory section, if nullptr a new section is allocated.
+     * @param newSize    The requested new size in bytes.
+     * @param align    The alignment of the memory section. Must be non-zero and a power of two.
+     * 
+     * @return Pointer to the resized memory section.
+     */
+    void* Reallocate(void* ptr, const size_t newSize, const size_t align = 1) override;
+
+    /* @brief Returns the number of bytes backed by memory, the whole managed memory unless it was reserved with VirtualReserve.
+     */
+    size_t committedMemory() const { return mCommittedAddress - mBaseAddress;}
+
 
 private:
 
+    /* @brief Commits the pages of a reserved range up to address, in steps of CommitGranularity to keep system calls rare.
+     *
+     * @param address    End address of the memory that must be accessible.
+     *
+     * @return False if the operating system refused to commit the memory.
+     */
+    bool Commit(const uintptr_t address);
+
+    // Pages are committed in steps of at least this size
+    static constexpr size_t CommitGranularity = 64 * 1024;
+
     uintptr_t mBaseAddress;
     uintptr_t mTopAddress;
+    // Address of the last allocation, 0 if it was freed
+    uintptr_t mLastAddress;
+    // All memory from this address on is known to be zero
+    uintptr_t mZeroedAddress;
+
+    // True if the managed memory is a reserved address range, committed up to mCommittedAddress
+    bool mReserved;
+    uintptr_t mCommittedAddress;
+    size_t mRetainedMemory;
 };
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "tagged_allocator.h"
+#include <ostream>
+
+
+namespace {
+
+    // Tag of the innermost Scope of the calling thread
+    thread_local uint32_t tCurrentTag = 0;
+}
+
+
+TaggedAllocator::Scope::Scope(const uint32_t tag) :
+    mPrevious {tCurrentTag}
+{
+    assert(tag < MaxTags);
+
+    tCurrentTag = tag;
+}
+
+TaggedAllocator::Scope::~Scope() {
+
+    tCurrentTag = mPrevious;
+}
+
+
+TaggedAllocator::TaggedAllocator(IAllocator &allocator) :
+    IAllocator(nullptr, allocator.totalMemory()),
+    mAllocator {allocator}
+{
+}
+
+TaggedAllocator::~TaggedAllocator() {
+
+}
+
+void* TaggedAllocator::Allocate(const size_t size, const size_t align) {
+
+    return Allocate(size, align, tCurrentTag);
+}
+
+void* TaggedAllocator::Allocate(const size_t size, const size_t align, const uint32_t tag) {
+
+    void *mem = AllocateTagged(size, align, tag, false);
+    if (mem == nullptr)
+    {
+        throw std::overflow_error(ExceedsBudget(tag, size) ? "Tagged allocator exceeded the budget of the tag." : "Tagged allocator is out of memory!");
+    }
+
+    return mem;
+}
+
+void* TaggedAllocator::TryAllocate(const size_t size, const size_t align) {
+
+    return AllocateTagged(size, align, tCurrentTag, false);
+}
+
+void* TaggedAllocator::TryAllocate(const size_t size, const size_t align, const uint32_t tag) {
+
+    return AllocateTagged(size, align, tag, false);
+}
+
+void* TaggedAllocator::AllocateZeroed(const size_t size, const size_t align) {
+
+    void *mem = AllocateTagged(size, align, tCurrentTag, true);
+    if (mem == nullptr)
+    {
+        throw std::overflow_error(ExceedsBudget(tCurrentTag, size) ? "Tagged allocator exceeded the budget of the tag." : "Tagged allocator is out of memory!");
+    }
+
+    return mem;
+}
+
+void TaggedAllocator::Free(void* ptr) {
+
+    assert(ptr != nullptr);
+
+    TagHeader *header = Header(ptr);
+    TagStats &stats = mStats[header->tag];
+    stats.liveBytes -= header->size;
+    stats.liveAllocations--;
+
+    mAllocator.Free(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) - header->padding));
+    mUsedMemory = mAllocator.usedMemory();
+}
+
+void TaggedAllocator::Clear() {
+
+    for (TagStats &stats : mStats)
+    {
+        stats.liveBytes = 0;
+        stats.liveAllocations = 0;
+    }
+
+    mAllocator.Clear();
+    mUsedMemory = mAllocator.usedMemory();
+}
+
+void* TaggedAllocator::Reallocate(void* ptr, const size_t newSize, const size_t align) {
+
+    if (!ptr)
+    {
+        return Allocate(newSize, align);
+    }
+
+    if ((reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0 && TryExpand(ptr, newSize))
+    {
+        return ptr;
+    }
+
+    // The old block is freed right after the copy, only the net growth counts against the budget
+    TagHeader *header = Header(ptr);
+    uint32_t tag = header->tag;
+    size_t oldSize = header->size;
+    mStats[tag].liveBytes -= oldSize;
+    void *mem = AllocateTagged(newSize, align, tag, false);
+    bool exceedsBudget = mem == nullptr && ExceedsBudget(tag, newSize);
+    mStats[tag].liveBytes += oldSize;
+    if (mem == nullptr)
+    {
+        throw std::overflow_error(exceedsBudget ? "Tagged allocator exceeded the budget of the tag." : "Tagged allocator is out of memory!");
+    }
+
+    std::memcpy(mem, ptr, std::min(oldSize, newSize));
+    Free(ptr);
+
+    return mem;
+}
+
+bool TaggedAllocator::Owns(const void* ptr) const {
+
+    return mAllocator.Owns(ptr);
+}
+
+size_t TaggedAllocator::AllocatedSize(const void* ptr) const {
+
+    const TagHeader *header = Header(ptr);
+
+    return mAllocator.AllocatedSize(reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(ptr) - header->padding)) - header->padding;
+}
+
+bool TaggedAllocator::TryExpand(void* ptr, const size_t newSize) {
+
+    assert(ptr != nullptr);
+
+    TagHeader *header = Header(ptr);
+    if (newSize <= header->size)
+    {
+        return true;
+    }
+
+    size_t growSize = newSize - header->size;
+    if (ExceedsBudget(header->tag, growSize) || !mAllocator.TryExpand(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) - header->padding), header->padding + newSize))
+    {
+        return false;
+    }
+
+    TagStats &stats = mStats[header->tag];
+    stats.liveBytes += growSize;
+    stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+    header->size = newSize;
+
+    mUsedMemory = mAllocator.usedMemory();
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return true;
+}
+
+void TaggedAllocator::SetBudget(const uint32_t tag, const size_t budget) {
+
+    assert(tag < MaxTags);
+
+    mStats[tag].budget = budget;
+}
+
+void TaggedAllocator::SetTagName(const uint32_t tag, const std::string &name) {
+
+    assert(tag < MaxTags);
+
+    mNames[tag] = name;
+}
+
+void TaggedAllocator::DumpText(std::ostream &out) const {
+
+    out << "tag, name, live bytes, peak bytes, live allocations, total allocations, failed allocations, budget\n";
+    for (uint32_t tag = 0; tag < MaxTags; tag++)
+    {
+        const TagStats &stats = mStats[tag];
+        if (stats.totalAllocations == 0 && stats.budget == 0)
+        {
+            continue;
+        }
+
+        out << tag << ", " << mNames[tag] << ", " << stats.liveBytes << ", " << stats.peakBytes << ", " << stats.liveAllocations << ", "
+            << stats.totalAllocations << ", " << stats.failedAllocations << ", " << stats.budget << '\n';
+    }
+}
+
+uint32_t TaggedAllocator::currentTag() {
+
+    return tCurrentTag;
+}
+
+void* TaggedAllocator::AllocateTagged(const size_t size, const size_t align, const uint32_t tag, const bool zeroed) {
+
+    assert(tag < MaxTags);
+
+    // Fail before touching the wrapped allocator, so a runaway subsystem cannot take memory from the others
+    TagStats &stats = mStats[tag];
+    if (ExceedsBudget(tag, size))
+    {
+        stats.failedAllocations++;
+        return nullptr;
+    }
+
+    size_t padding = Padding(align);
+    void *mem = zeroed ? mAllocator.AllocateZeroed(padding + size, HeaderAlign(align)) : mAllocator.TryAllocate(padding + size, HeaderAlign(align));
+    if (mem == nullptr)
+    {
+        return nullptr;
+    }
+
+    void *ptr = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(mem) + padding);
+    *Header(ptr) = {size, tag, static_cast<uint32_t>(padding)};
+
+    stats.liveBytes += size;
+    stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+    stats.liveAllocations++;
+    stats.totalAllocations++;
+
+    mUsedMemory = mAllocator.usedMemory();
+    mMaxUsedMemory = std::max(mMaxUsedMemory, mUsedMemory);
+
+    return ptr;
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <iosfwd>
+#include <string>
+
+
+/* @brief Accounting implementation of IAllocator, forwarding all calls to another allocator and attributing every allocation to a tag.
+ *
+ * Tags are small integers below MaxTags naming the subsystem an allocation belongs to, tag 0 collects untagged allocations.
+ * The tag of an allocation is passed explicitly or taken from the innermost Scope of the calling thread.
+ * Keeps live bytes, peak bytes and allocation counts per tag and rejects allocations that would exceed the budget of their tag,
+ * Allocate() by throwing std::overflow_error and TryAllocate() by returning nullptr, before the wrapped allocator is touched.
+ * Stores the tag and size of every allocation in a TagHeader in front of the returned memory, so Free() needs no lookup.
+ *
+ * Not thread-safe, like the wrapped allocators. Scopes are per thread.
+ *
+ * @class
+ */
+class TaggedAllocator : public IAllocator{
+
+    struct TagHeader {
+
+        // Requested size, tag and distance from the start of the wrapped allocation
+        size_t size;
+        uint32_t tag;
+        uint32_t padding;
+    };
+
+public:
+
+    static constexpr uint32_t MaxTags = 64;
+
+    /* @brief Accounting of one tag, sizes are requested sizes without headers.
+     */
+    struct TagStats {
+
+        size_t liveBytes = 0;
+        size_t peakBytes = 0;
+        size_t liveAllocations = 0;
+        size_t totalAllocations = 0;
+        // Allocations rejected because of the budget
+        size_t failedAllocations = 0;
+        // Maximum live bytes, zero for no limit
+        size_t budget = 0;
+    };
+
+    /* @brief Sets the tag of all allocations of the calling thread without explicit tag while it is alive, restores the previous tag on destruction.
+     *
+     * @class
+     */
+    class Scope {
+
+    public:
+
+        Scope() = delete;
+
+        explicit Scope(const uint32_t tag);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+
+    private:
+
+        uint32_t mPrevious;
+    };
+
+
+    TaggedAllocator() = delete;
+
+    /* @brief Constructor that wraps an allocator.
+     *
+     * @param allocator    The allocator to forward all calls to.
+     */
+    explicit TaggedAllocator(IAllocator &allocator);
+
+    /* @brief Default destructor that does nothing.
+     */
+    ~TaggedAllocator();
+
+    /* @brief Allocates memory for the tag of the current Scope from the wrapped allocator.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Allocates memory for a tag from the wrapped allocator, throws std::overflow_error if the budget of the tag would be exceeded.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * @param tag    The tag to account the allocation to.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align, const uint32_t tag);
+
+    /* @brief Allocates memory for the tag of the current Scope, returns nullptr if the budget of the tag would be exceeded or the wrapped allocator is out of memory.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory or nullptr.
+     */
+    void* TryAllocate(const size_t size, const size_t align = 1) override;
+
+    /* @brief Allocates memory for a tag, returns nullptr if the budget of the tag would be exceeded or the wrapped allocator is out of memory.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     * @param tag    The tag to account the allocation to.
+     *
+     * return Pointer to the allocated memory or nullptr.
+     */
+    void* TryAllocate(const size_t size, const size_t align, const uint32_t tag);
+
+    /* @brief Allocates zero filled memory for the tag of the current Scope from the wrapped allocator.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section. Must be non-zero and a power of two.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* AllocateZeroed(const size_t size, const size_t align = 1) override;
+
+    /* @brief Frees memory in the wrapped allocator and subtracts it from the live bytes of its tag.
+     *
+     * @param ptr    Pointer to the memory position to free.
+     */
+    void  Free(void* ptr) override;
+
+    /* @brief Clears the wrapped allocator and the live bytes of all tags, keeping peaks, totals and budgets.
+     */
+    void  Clear() override;
+
+    /* @brief Resizes an allocation, a moved allocation keeps its tag and only its growth is checked against the budget of that tag.
+     *
+     * @param ptr    Pointer to the allocated memory section, if nullptr a new section is allocated for the tag of the current Scope.
+     * @param newSize    The requested new size in bytes.
+     * @param align    The alignment of the memory section. Must be non-zero and a power of two.
+     *
+     * @return Pointer to the resized memory section.
+     */
+    void* Reallocate(void* ptr, const size_t newSize, const size_t align = 1) override;
+
+    bool   Owns(const void* ptr) const override;
+    size_t AllocatedSize(const void* ptr) const override;
+    bool   TryExpand(void* ptr, const size_t newSize) override;
+
+    /* @brief Limits the live bytes of a tag.
+     *
+     * @param tag    The tag to limit.
+     * @param budget    Maximum live bytes of the tag, zero for no limit.
+     */
+    void SetBudget(const uint32_t tag, const size_t budget);
+
+    /* @brief Names a tag in DumpText().
+     *
+     * @param tag    The tag to name.
+     * @param name    Name of the subsystem using the tag.
+     */
+    void SetTagName(const uint32_t tag, const std::string &name);
+
+    /* @brief Writes the accounting of all used tags, one line per tag.
+     *
+     * @param out    Stream to write to.
+     */
+    void DumpText(std::ostream &out) const;
+
+    /* @brief Returns the tag of an allocation.
+     *
+     * @param ptr    Pointer to the allocated memory section.
+     */
+    uint32_t TagOf(const void* ptr) const { return Header(ptr)->tag;}
+
+    const TagStats& stats(const uint32_t tag) const { assert(tag < MaxTags); return mStats[tag];}
+
+    /* @brief Returns the tag of the innermost Scope of the calling thread, 0 outside of any Scope.
+     */
+    static uint32_t currentTag();
+
+
+private:
+
+    /* @brief Checks the budget and allocates from the wrapped allocator with room for the TagHeader.
+     *
+     * @param size    The size of the allocated memory section.
+     * @param align    The alignment of the allocated memory section.
+     * @param tag    The tag to account the allocation to.
+     * @param zeroed    Allocate zero filled memory.
+     *
+     * return Pointer to the allocated memory, nullptr if the budget would be exceeded or the wrapped allocator is out of memory.
+     */
+    void* AllocateTagged(const size_t size, const size_t align, const uint32_t tag, const bool zeroed);
+
+    /* @brief Returns true if allocating size more bytes for a tag would exceed its budget.
+     *
+     * @param tag    The tag of the allocation.
+     * @param size    The number of additional live bytes.
+     */
+    bool ExceedsBudget(const uint32_t tag, const size_t size) const { return mStats[tag].budget > 0 && mStats[tag].liveBytes + size > mStats[tag].budget;}
+
+    /* @brief Returns the alignment to request from the wrapped allocator, at least the alignment of the TagHeader.
+     *
+     * @param align    The alignment of the allocated memory section.
+     */
+    static size_t HeaderAlign(const size_t align) { return std::max(align, alignof(TagHeader));}
+
+    /* @brief Returns the distance between the start of the wrapped allocation and the returned memory, large enough for a TagHeader and a multiple of align.
+     *
+     * @param align    The alignment of the allocated memory section.
+     */
+    static size_t Padding(const size_t align) { return (sizeof(TagHeader) + HeaderAlign(align) - 1) & ~(HeaderAlign(align) - 1);}
+
+    static TagHeader* Header(const void* ptr) { return reinterpret_cast<TagHeader*>(reinterpret_cast<uintptr_t>(ptr) - sizeof(TagHeader));}
+
+
+    IAllocator &mAllocator;
+
+    TagStats mStats[MaxTags];
+    std::string mNames[MaxTags];
+};
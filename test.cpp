@@ -1,16 +1,21 @@
 
+#include "bitmap_pool_allocator.h"
+#include "coroutine_allocator.h"
 #include "free_list_allocator.h"
 #include "free_tree_allocator.h"
 #include "pool_allocator.h"
 #include "stack_allocator.h"
+#include "workload.h"
 
 #include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <queue>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 
@@ -58,7 +63,7 @@ void benchmarkStack(size_t totalMemory, size_t numOperations) {
 }
 
 
-void benchmarkList(size_t totalMemory, size_t numOperations) {
+void benchmarkList(size_t totalMemory, size_t numOperations, size_t maxFastSize = 0) {
   
     std::vector<size_t> allocationSizes = {16, 64, 256, 1024, 4096, 16384};
     std::unordered_set<void*> ptrs;
@@ -68,6 +73,7 @@ void benchmarkList(size_t totalMemory, size_t numOperations) {
     srand(seed);
 
     FreeListAllocator listAlloc(totalMemory);
+    listAlloc.SetFastBins(maxFastSize);
 
     Clock clock;    
     Time start = clock.now();
@@ -110,13 +116,13 @@ void benchmarkList(size_t totalMemory, size_t numOperations) {
     
     Time end = clock.now();
 
-    std::cout << "FreeListAllocator : " << numOperations << " operations in " << duration(start, end) / 1000000.0 << " s" << " , max memory " << listAlloc.maxUsedMemory() << '\n';
+    std::cout << "FreeListAllocator (fast bins up to " << maxFastSize << ") : " << numOperations << " operations in " << duration(start, end) / 1000000.0 << " s" << " , max memory " << listAlloc.maxUsedMemory() << '\n';
 
     std::cout << " used " << listAlloc.usedMemory()  << ", free " << listAlloc.totalMemory() - listAlloc.usedMemory() << '\n';
 }
 
 
-void benchmarkTree(size_t totalMemory, size_t numOperations) {
+void benchmarkTree(size_t totalMemory, size_t numOperations, size_t maxPending = 0) {
 
     std::vector<size_t> allocationSizes = {16, 64, 256, 1024, 4096, 16384};
     std::unordered_set<void*> ptrs;
@@ -126,6 +132,7 @@ void benchmarkTree(size_t totalMemory, size_t numOperations) {
     srand(seed);
 
     FreeTreeAllocator treeAlloc(totalMemory);
+    treeAlloc.SetMaxPending(maxPending);
 
     Clock clock;    
     Time start = clock.now();
@@ -168,7 +175,7 @@ void benchmarkTree(size_t totalMemory, size_t numOperations) {
 
     Time end = clock.now();
 
-    std::cout << "FreeTreeAllocator : " << numOperations << " operations in " << duration(start, end) / 1000000.0 << " s" << " , max memory " << treeAlloc.maxUsedMemory() << '\n';
+    std::cout << "FreeTreeAllocator (" << maxPending << " pending) : " << numOperations << " operations in " << duration(start, end) / 1000000.0 << " s" << " , max memory " << treeAlloc.maxUsedMemory() << '\n';
 
     std::cout << " used " << treeAlloc.usedMemory()  << ", free " << treeAlloc.totalMemory() - treeAlloc.usedMemory() << '\n';
 }
@@ -229,6 +236,60 @@ void benchmarkPool(size_t totalMemory, size_t nodeSize, size_t numOperations) {
 }
 
 
+void benchmarkBitmapPool(size_t totalMemory, size_t nodeSize, size_t numOperations) {
+  
+    std::unordered_set<void*> ptrs;
+
+    auto seed = time(nullptr);
+    std::cout << seed << '\n';
+    srand(seed);
+
+    BitmapPoolAllocator poolAlloc(totalMemory, nodeSize);
+
+    Clock clock;    
+    Time start = clock.now();
+
+    // calls to Allocate() and Free()
+    // if out of memory do up to 10 calls to Free() to create space
+    for (size_t i = 0; i < numOperations; i++)
+    {
+        if(rand() % 3 == 0 && !ptrs.empty())
+        {
+            auto pos = std::next(ptrs.begin(), rand() % ptrs.size());
+            poolAlloc.Free( *(pos) );
+            ptrs.erase(pos);
+            continue;
+        }
+         
+        try
+        {
+            void *p = poolAlloc.Allocate(nodeSize);
+            ptrs.insert(p);
+        }
+        catch(const std::exception& e)
+        {
+            
+            for (size_t j = 0; j < 10; j++)
+            {
+                if(ptrs.empty())
+                {
+                    break;
+                }
+
+                auto pos = std::next(ptrs.begin(), rand() % ptrs.size());
+                poolAlloc.Free( *(pos) );
+                ptrs.erase(pos);
+                ++i;
+            }            
+        }        
+    }
+
+    Time end = clock.now();
+
+    std::cout << "BitmapPoolAllocator : " << numOperations << " operations in " << duration(start, end) / 1000000.0 << " s" << " , max memory " << poolAlloc.maxUsedMemory() << '\n'; 
+}
+
+
 void benchmarkMalloc(size_t numOperations) {
 
     std::vector<size_t> allocationSizes = {16, 64, 256, 1024, 4096, 16384};
@@ -264,6 +325,150 @@ void benchmarkMalloc(size_t numOperations) {
 }
 
 
+#if defined(__cpp_impl_coroutine)
+
+// Minimal eagerly started coroutine, the frame lives until the Task is destroyed
+struct FrameTask {
+
+    struct promise_type : AllocatorPromise {
+
+        FrameTask get_return_object() { return FrameTask{std::coroutine_handle<promise_type>::from_promise(*this)};}
+        std::suspend_never initial_suspend() noexcept { return {};}
+        std::suspend_always final_suspend() noexcept { return {};}
+        void return_value(size_t value) { result = value;}
+        void unhandled_exception() { std::terminate();}
+
+        size_t result = 0;
+    };
+
+    explicit FrameTask(std::coroutine_handle<promise_type> handle_) : handle {handle_} {}
+    FrameTask(FrameTask &&other) noexcept : handle {std::exchange(other.handle, nullptr)} {}
+    ~FrameTask() { if (handle) handle.destroy();}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+FrameTask heapFrame(size_t value) {
+
+    co_return value * 3;
+}
+
+FrameTask arenaFrame(size_t value, IAllocator &/*frameAlloc*/) {
+
+    co_return value * 3;
+}
+
+
+void benchmarkCoroutines(size_t numFrames, size_t framesPerRequest) {
+
+    std::vector<FrameTask> tasks;
+    tasks.reserve(framesPerRequest);
+    size_t checksum = 0;
+
+    // every request creates framesPerRequest frames and destroys them at its end
+    auto run = [&](const char *name, auto createFrame, auto endRequest) {
+
+        Clock clock;
+        Time start = clock.now();
+
+        for (size_t i = 0; i < numFrames; i += framesPerRequest)
+        {
+            for (size_t j = 0; j < framesPerRequest; j++)
+            {
+                tasks.push_back(createFrame(j));
+                checksum += tasks.back().handle.promise().result;
+            }
+            tasks.clear();
+            endRequest();
+        }
+
+        Time end = clock.now();
+
+        std::cout << name << " : " << numFrames / (duration(start, end) / 1000000.0) << " frames/s" << '\n';
+    };
+
+    run("coroutine frames global heap", [](size_t j) { return heapFrame(j);}, []() {});
+
+    PoolAllocator poolAlloc(framesPerRequest * 256, 256);
+    run("coroutine frames PoolAllocator", [&](size_t j) { return arenaFrame(j, poolAlloc);}, []() {});
+
+    StackAllocator stAlloc(framesPerRequest * 256);
+    run("coroutine frames StackAllocator", [&](size_t j) { return arenaFrame(j, stAlloc);}, [&]() { stAlloc.Clear();});
+
+    std::cout << "checksum " << checksum << '\n';
+}
+
+#endif
+
+
+
+template<typename A>
+void reportFragmentation(const std::string &name, A &alloc, const WorkloadConfig &config, uint64_t reportInterval) {
+
+    const char *phases[] = {"ramp", "steady", "drain", "done"};
+
+    Workload workload(config);
+    Workload::Operation op;
+    std::vector<void*> ptrs;
+    uint64_t failures = 0;
+
+    std::cout << "allocator,phase,operations,live objects,used memory,largest free block,free blocks,failures,Mops/s\n";
+
+    Clock clock;
+    Time start = clock.now();
+
+    auto report = [&](uint64_t numOperations) {
+
+        Time end = clock.now();
+
+        std::cout << name << ',' << phases[static_cast<int>(workload.phase())] << ',' << workload.operations() << ',' << workload.liveObjects() << ','
+                  << alloc.usedMemory() << ',' << alloc.largestFreeBlock() << ',' << alloc.freeBlocks() << ',' << failures << ','
+                  << numOperations / static_cast<double>(std::max<int64_t>(duration(start, end), 1)) << '\n';
+
+        // collecting the free block statistics walks the whole allocator and is not timed
+        start = clock.now();
+    };
+
+    // replay the workload and print one row of the time series every reportInterval operations and at the end
+    // failed allocations are counted and skipped, their frees are ignored
+    while (workload.Next(op))
+    {
+        if (op.allocate)
+        {
+            if (op.id >= ptrs.size())
+            {
+                ptrs.resize(op.id + 1);
+            }
+
+            try
+            {
+                ptrs[op.id] = alloc.Allocate(op.size, 8);
+            }
+            catch(const std::overflow_error& e)
+            {
+                ptrs[op.id] = nullptr;
+                ++failures;
+            }
+        }
+        else if (ptrs[op.id])
+        {
+            alloc.Free(ptrs[op.id]);
+        }
+
+        if (workload.operations() % reportInterval == 0)
+        {
+            report(reportInterval);
+        }
+    }
+
+    // the last sample already shows the final state if the operations ended on a report
+    if (workload.operations() % reportInterval != 0)
+    {
+        report(workload.operations() % reportInterval);
+    }
+}
+
+
 int main(int argc, char *argv[]) {
  
     uint32_t KB = 1024;
@@ -272,8 +477,27 @@ int main(int argc, char *argv[]) {
     benchmarkMalloc(1000000);
     // benchmarkStack(10*MB, 1000000);
     benchmarkList(10*MB, 1000000);
+    // benchmarkList(10*MB, 1000000, 256);
     benchmarkTree(10*MB, 1000000);
+    // benchmarkTree(10*MB, 1000000, 256);
     // benchmarkPool(10*MB, 1*KB, 1000000);
+    // benchmarkBitmapPool(10*MB, 1*KB, 1000000);
+#if defined(__cpp_impl_coroutine)
+    // benchmarkCoroutines(10000000, 64);
+#endif
+
+    // long running fragmentation report, power law sizes with alternating short and long lived phases
+    // WorkloadConfig config;
+    // config.sizes = WorkloadConfig::SizeDistribution::PowerLaw;
+    // config.lifetimes = WorkloadConfig::LifetimeDistribution::PhaseChange;
+    // config.steadyOperations = 300000000;
+    // FreeListAllocator listAlloc(256*MB);
+    // reportFragmentation("FreeListAllocator", listAlloc, config, 10000000);
+    // BasicFreeListAllocator<Placement::BestFit> bestFitAlloc(256*MB);
+    // reportFragmentation("FreeListAllocator best fit", bestFitAlloc, config, 10000000);
+    // FreeTreeAllocator treeAlloc(256*MB);
+    // treeAlloc.SetDirectMapThreshold(MB);
+    // reportFragmentation("FreeTreeAllocator", treeAlloc, config, 10000000);
 
 
     return 0;
@@ -0,0 +1,208 @@
+#pragma once
+
+
+#include "allocator.h"
+
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+/* @brief Pool of Capacity chunks, each holding one object of type T, with chunk size and alignment computed at compile time.
+ *
+ * Keeps track of freed chunks with an intrusive linked list and hands out never used chunks in address order, so construction and Clear() do not touch the memory.
+ * Small pools keep their chunks inside the object, larger ones allocate them from the global heap, neither depends on a parent allocator.
+ * All methods are defined in the header and can be inlined into the caller.
+ *
+ * @class
+ */
+template<typename T, size_t Capacity, bool InlineStorage = (Capacity * std::max(sizeof(T), sizeof(void*)) <= 4096)>
+class TypedPool {
+
+    static_assert(Capacity > 0, "Typed pool needs at least one chunk.");
+
+    union Chunk {
+
+        Chunk *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+public:
+
+    static constexpr size_t ChunkSize = sizeof(Chunk);
+    static constexpr size_t ChunkAlign = alignof(Chunk);
+
+    /* @brief Constructor that provides the chunk storage, either in place or from the global heap.
+     */
+    TypedPool();
+
+    /* @brief Destructor that releases heap allocated chunk storage. Does not destroy objects still alive in the pool.
+     */
+    ~TypedPool();
+
+    TypedPool(const TypedPool&) = delete;
+    TypedPool& operator=(const TypedPool&) = delete;
+
+    /* @brief Allocates an uninitialized chunk for one object of type T.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate();
+
+    /* @brief Allocates an uninitialized chunk, to be used in place of other allocators.
+     *
+     * @param size    The size of the allocated memory section, must not exceed ChunkSize.
+     * @param align    The alignment of the allocated memory section, must not exceed ChunkAlign.
+     *
+     * return Pointer to the allocated memory.
+     */
+    void* Allocate(const size_t size, const size_t align = 1);
+
+    /* @brief Frees the chunk at ptr and makes it the new head of the free list.
+     *
+     * @param ptr    Pointer to the chunk to free.
+     */
+    void  Free(void* ptr);
+
+    /* @brief Frees all chunks without touching their memory.
+     */
+    void  Clear();
+
+    /* @brief Constructs a new object of type T in a free chunk.
+     *
+     * @param args    Argument list for constructor.
+     *
+     * @return Pointer to the initialized object.
+     */
+    template<typename... Args>
+    T* New(Args&&... args);
+
+    /* @brief Destroys an object of type T and frees its chunk.
+     *
+     * @param obj    Pointer to the object that should be deleted.
+     */
+    void Delete(T* obj);
+
+    bool Owns(const void* ptr) const;
+
+    static constexpr size_t capacity() { return Capacity;}
+
+    size_t  totalMemory()   const { return Capacity * ChunkSize;}
+    size_t  usedMemory()    const { return mUsedChunks * ChunkSize;}
+    size_t  maxUsedMemory() const { return mMaxUsedChunks * ChunkSize;}
+
+
+private:
+
+    Chunk*          chunks()       { return &mChunks[0];}
+    const Chunk*    chunks() const { return &mChunks[0];}
+
+
+    std::conditional_t<InlineStorage, Chunk[Capacity], Chunk*> mChunks;
+
+    Chunk *pHead;
+    // Number of chunks handed out at least once, all chunks above were never touched
+    size_t mNumTouched;
+    size_t mUsedChunks;
+    size_t mMaxUsedChunks;
+};
+
+
+template<typename T, size_t Capacity, bool InlineStorage>
+TypedPool<T, Capacity, InlineStorage>::TypedPool() :
+    pHead {nullptr},
+    mNumTouched {0},
+    mUsedChunks {0},
+    mMaxUsedChunks {0}
+{
+    if constexpr (!InlineStorage)
+    {
+        mChunks = static_cast<Chunk*>(::operator new(Capacity * ChunkSize, std::align_val_t {ChunkAlign}));
+    }
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+TypedPool<T, Capacity, InlineStorage>::~TypedPool() {
+
+    if constexpr (!InlineStorage)
+    {
+        ::operator delete(mChunks, std::align_val_t {ChunkAlign});
+    }
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline void* TypedPool<T, Capacity, InlineStorage>::Allocate() {
+
+    Chunk *chunk = pHead;
+    if (chunk)
+    {
+        pHead = chunk->next;
+    }
+    else if (mNumTouched < Capacity)
+    {
+        chunk = chunks() + mNumTouched++;
+    }
+    else
+    {
+        throw std::overflow_error("Typed pool is out of memory!");
+    }
+
+    ++mUsedChunks;
+    mMaxUsedChunks = std::max(mMaxUsedChunks, mUsedChunks);
+
+    return static_cast<void*>(chunk);
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline void* TypedPool<T, Capacity, InlineStorage>::Allocate(const size_t size, const size_t align) {
+
+    assert(size <= ChunkSize);
+    assert(ChunkAlign % align == 0);
+
+    return Allocate();
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline void TypedPool<T, Capacity, InlineStorage>::Free(void* ptr) {
+
+    assert(Owns(ptr));
+
+    Chunk *chunk = static_cast<Chunk*>(ptr);
+    chunk->next = pHead;
+    pHead = chunk;
+
+    --mUsedChunks;
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline void TypedPool<T, Capacity, InlineStorage>::Clear() {
+
+    pHead = nullptr;
+    mNumTouched = 0;
+    mUsedChunks = 0;
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+template<typename... Args>
+inline T* TypedPool<T, Capacity, InlineStorage>::New(Args&&... args) {
+
+    void *mem = Allocate();
+    return new (mem) T(std::forward<Args>(args)...);
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline void TypedPool<T, Capacity, InlineStorage>::Delete(T* obj) {
+
+    obj->~T();
+    Free(static_cast<void*>(obj));
+}
+
+template<typename T, size_t Capacity, bool InlineStorage>
+inline bool TypedPool<T, Capacity, InlineStorage>::Owns(const void* ptr) const {
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    uintptr_t baseAddress = reinterpret_cast<uintptr_t>(chunks());
+
+    return address >= baseAddress && address < baseAddress + Capacity * ChunkSize;
+}
@@ -0,0 +1,164 @@
+#include "virtual_memory.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+
+size_t VirtualMemory::PageSize() {
+
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return pageSize;
+}
+
+size_t VirtualMemory::DiscardPages(uintptr_t begin, uintptr_t end, const bool lazy) {
+
+    size_t pageSize = PageSize();
+    begin = (begin + pageSize - 1) & ~(pageSize - 1);
+    end &= ~(pageSize - 1);
+    if (begin >= end)
+    {
+        return 0;
+    }
+
+    int advice = MADV_DONTNEED;
+#ifdef MADV_FREE
+    if (lazy)
+    {
+        advice = MADV_FREE;
+    }
+#endif
+
+    if (madvise(reinterpret_cast<void*>(begin), end - begin, advice) != 0)
+    {
+        return 0;
+    }
+
+    return end - begin;
+}
+
+size_t VirtualMemory::ResidentBytes(const void* ptr, const size_t size) {
+
+    size_t pageSize = PageSize();
+    uintptr_t begin = reinterpret_cast<uintptr_t>(ptr) & ~(pageSize - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size + pageSize - 1) & ~(pageSize - 1);
+
+    std::vector<unsigned char> pages((end - begin) / pageSize);
+    if (pages.empty() || mincore(reinterpret_cast<void*>(begin), end - begin, pages.data()) != 0)
+    {
+        return 0;
+    }
+
+    size_t residentPages = 0;
+    for (unsigned char page : pages)
+    {
+        residentPages += page & 1;
+    }
+
+    return residentPages * pageSize;
+}
+
+void* VirtualMemory::MapPages(const size_t size) {
+
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+void VirtualMemory::UnmapPages(void* ptr, const size_t size) {
+
+    munmap(ptr, size);
+}
+
+void* VirtualMemory::ReservePages(const size_t size) {
+
+    void *ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return ptr == MAP_FAILED ? nullptr : ptr;
+}
+
+bool VirtualMemory::CommitPages(void* ptr, const size_t size) {
+
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void VirtualMemory::DecommitPages(void* ptr, const size_t size) {
+
+    // Mapping fresh inaccessible pages over the range drops the old pages and their commit charge at once
+    mmap(ptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+}
+
+
+MappedFile::MappedFile(const char *path, const size_t size, const bool sharedMemory) :
+    pData {nullptr},
+    mSize {size},
+    mCreated {false}
+{
+    // Exclusive creation decides which process initializes the content
+    int flags = O_RDWR | O_CREAT | O_EXCL;
+    int fd = sharedMemory ? shm_open(path, flags, 0644) : open(path, flags, 0644);
+    mCreated = fd >= 0;
+    if (fd < 0 && errno == EEXIST)
+    {
+        fd = sharedMemory ? shm_open(path, O_RDWR, 0644) : open(path, O_RDWR);
+    }
+
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), std::string("Could not open ") + path);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), std::string("Could not stat ") + path);
+    }
+
+    if (status.st_size == 0 && !mCreated && sharedMemory)
+    {
+        close(fd);
+        throw std::runtime_error(std::string(path) + " is not initialized yet.");
+    }
+
+    if (status.st_size == 0)
+    {
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), std::string("Could not resize ") + path);
+        }
+        mCreated = true;
+    }
+    else
+    {
+        mSize = static_cast<size_t>(status.st_size);
+    }
+
+    void *data = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        throw std::system_error(error, std::generic_category(), std::string("Could not map ") + path);
+    }
+
+    pData = data;
+}
+
+MappedFile::~MappedFile() {
+
+    munmap(pData, mSize);
+}
+
+void MappedFile::Sync() {
+
+    msync(pData, mSize, MS_SYNC);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* Thin wrappers around the virtual memory system calls used by the allocators.
+ */
+namespace VirtualMemory {
+
+    /* @brief Returns the size of a virtual memory page in bytes.
+     */
+    size_t PageSize();
+
+    /* @brief Gives the physical pages lying completely inside an address range back to the operating system.
+     * The memory stays mapped and reads as zero or its old content (lazy) after the next access.
+     *
+     * @param begin    Start address of the range.
+     * @param end    End address of the range.
+     * @param lazy    Use MADV_FREE instead of MADV_DONTNEED, so pages are only reclaimed under memory pressure.
+     * 
+     * @return The number of bytes given back.
+     */
+    size_t DiscardPages(uintptr_t begin, uintptr_t end, const bool lazy = false);
+
+    /* @brief Counts the bytes of all pages overlapping a memory range that are currently resident in physical memory.
+     *
+     * @param ptr    Start of the memory range.
+     * @param size    Size of the memory range in bytes.
+     * 
+     * @return The resident size in bytes.
+     */
+    size_t ResidentBytes(const void* ptr, const size_t size);
+
+    /* @brief Maps fresh zero filled private pages that belong to no other allocation.
+     *
+     * @param size    Size of the mapping in bytes, rounded up to whole pages.
+     * 
+     * @return Pointer to the mapping, or nullptr if the operating system refused.
+     */
+    void* MapPages(const size_t size);
+
+    /* @brief Unmaps pages returned by MapPages(), giving them back to the operating system immediately.
+     *
+     * @param ptr    Pointer returned by MapPages().
+     * @param size    The size passed to MapPages().
+     */
+    void UnmapPages(void* ptr, const size_t size);
+
+    /* @brief Reserves a range of virtual addresses without backing it by memory, every access faults until the pages are committed.
+     *
+     * @param size    Size of the range in bytes, rounded up to whole pages.
+     * 
+     * @return Pointer to the range, or nullptr if the operating system refused.
+     */
+    void* ReservePages(const size_t size);
+
+    /* @brief Makes pages of a reserved range readable and writable, they read as zero on first access.
+     *
+     * @param ptr    Page aligned start of the pages.
+     * @param size    Size of the pages in bytes, a multiple of the page size.
+     * 
+     * @return False if the operating system refused.
+     */
+    bool CommitPages(void* ptr, const size_t size);
+
+    /* @brief Gives committed pages back to the operating system and makes them inaccessible again, the range stays reserved.
+     *
+     * @param ptr    Page aligned start of the pages.
+     * @param size    Size of the pages in bytes, a multiple of the page size.
+     */
+    void DecommitPages(void* ptr, const size_t size);
+}
+
+
+/* @brief Option for arenas to reserve their address range up front and commit memory only as it is used.
+ */
+struct VirtualReserve {
+
+    // Bytes from the beginning of the range that stay committed when the arena is cleared
+    size_t retainedMemory = 0;
+};
+
+
+/* @brief Shared read-write mapping of a file or POSIX shared memory object into memory, so changes to the memory are written back and visible to other processes.
+ * 
+ * Creates the file with the requested size if it does not exist or is empty, otherwise maps the whole existing file.
+ * An existing shared memory object that is still empty is not resized, because its creator is about to do so.
+ * Unmaps the file on destruction.
+ * 
+ * @class 
+ */
+class MappedFile {
+
+public:
+
+    MappedFile() = delete;
+
+    /* @brief Constructor that opens or creates the file and maps it into memory.
+     *
+     * @param path    Path of the file, or name of the shared memory object.
+     * @param size    Size in bytes of a newly created file.
+     * @param sharedMemory    Open a POSIX shared memory object with shm_open() instead of a file.
+     */
+    MappedFile(const char *path, const size_t size, const bool sharedMemory = false);
+
+    /* @brief Destructor that unmaps the file.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /* @brief Writes all changes of the mapped memory back to the file.
+     */
+    void Sync();
+
+    void*   data()      const { return pData;}
+    size_t  size()      const { return mSize;}
+    // True if the file was created by this mapping
+    bool    created()   const { return mCreated;}
+
+
+private:
+
+    void* pData;
+    size_t mSize;
+    bool mCreated;
+};
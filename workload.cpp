@@ -0,0 +1,156 @@
+#include "workload.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+Workload::Workload(const WorkloadConfig &config) :
+    mConfig {config},
+    mPhase {Phase::Ramp},
+    mOperations {0},
+    mRandom {config.seed},
+    mUniform {0.0, 1.0},
+    mNextId {0}
+{
+    assert(mConfig.minSize > 0 && mConfig.minSize <= mConfig.maxSize);
+
+    std::vector<double> weights;
+    for (auto &[size, weight] : mConfig.fixedSizes)
+    {
+        weights.push_back(weight);
+    }
+    mFixedSizes = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+}
+
+bool Workload::Next(Operation &op) {
+
+    if (mPhase == Phase::Ramp && mOperations >= mConfig.rampOperations)
+    {
+        mPhase = Phase::Steady;
+    }
+    if (mPhase == Phase::Steady && mOperations - mConfig.rampOperations >= mConfig.steadyOperations)
+    {
+        mPhase = Phase::Drain;
+    }
+    if (mPhase == Phase::Drain && (mDeaths.empty() || mOperations - mConfig.rampOperations - mConfig.steadyOperations >= mConfig.drainOperations))
+    {
+        mPhase = Phase::Done;
+    }
+
+    switch (mPhase)
+    {
+        case Phase::Ramp:
+            // Ramp objects start to age when the steady phase begins
+            Allocate(op, mConfig.rampOperations);
+            break;
+
+        case Phase::Steady:
+            if (!mDeaths.empty() && mDeaths.top().first <= mOperations)
+            {
+                Free(op);
+            }
+            else
+            {
+                Allocate(op, mOperations);
+            }
+            break;
+
+        case Phase::Drain:
+            Free(op);
+            break;
+
+        case Phase::Done:
+            return false;
+    }
+
+    ++mOperations;
+
+    return true;
+}
+
+size_t Workload::DrawSize() {
+
+    double u = mUniform(mRandom);
+    double minSize = static_cast<double>(mConfig.minSize);
+    double maxSize = static_cast<double>(mConfig.maxSize);
+
+    switch (mConfig.sizes)
+    {
+        case WorkloadConfig::SizeDistribution::Uniform:
+            return mConfig.minSize + static_cast<size_t>(u * (mConfig.maxSize - mConfig.minSize + 1)) % (mConfig.maxSize - mConfig.minSize + 1);
+
+        case WorkloadConfig::SizeDistribution::PowerLaw:
+        {
+            // Inverse of the cumulative distribution function of the bounded Pareto distribution
+            double a = mConfig.powerLawExponent;
+            double lowPow = std::pow(minSize, a);
+            double highPow = std::pow(maxSize, a);
+            double size = std::pow(-(u * highPow - u * lowPow - highPow) / (highPow * lowPow), -1.0 / a);
+            return std::clamp(static_cast<size_t>(size), mConfig.minSize, mConfig.maxSize);
+        }
+
+        case WorkloadConfig::SizeDistribution::Bimodal:
+        {
+            double v = mUniform(mRandom);
+            if (u < mConfig.largeFraction)
+            {
+                return static_cast<size_t>(maxSize / 2 + v * maxSize / 2);
+            }
+            return std::min(mConfig.maxSize, static_cast<size_t>(minSize + v * minSize));
+        }
+
+        case WorkloadConfig::SizeDistribution::FixedMix:
+            return mConfig.fixedSizes[mFixedSizes(mRandom)].first;
+    }
+
+    return mConfig.minSize;
+}
+
+uint64_t Workload::DrawLifetime() {
+
+    bool longLived = false;
+    switch (mConfig.lifetimes)
+    {
+        case WorkloadConfig::LifetimeDistribution::Short:
+            break;
+
+        case WorkloadConfig::LifetimeDistribution::Long:
+            longLived = mUniform(mRandom) < mConfig.longFraction;
+            break;
+
+        case WorkloadConfig::LifetimeDistribution::PhaseChange:
+            longLived = (mOperations / mConfig.phaseLength) % 2 == 1;
+            break;
+    }
+
+    double mean = longLived ? mConfig.longLifetime : mConfig.shortLifetime;
+
+    return static_cast<uint64_t>(-std::log(1.0 - mUniform(mRandom)) * mean) + 1;
+}
+
+void Workload::Allocate(Operation &op, const uint64_t start) {
+
+    size_t id = mNextId;
+    if (!mFreeIds.empty())
+    {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+    }
+    else
+    {
+        ++mNextId;
+    }
+
+    mDeaths.push({start + DrawLifetime(), id});
+
+    op = {true, id, DrawSize()};
+}
+
+void Workload::Free(Operation &op) {
+
+    size_t id = mDeaths.top().second;
+    mDeaths.pop();
+    mFreeIds.push_back(id);
+
+    op = {false, id, 0};
+}
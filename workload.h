@@ -0,0 +1,143 @@
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+/* @brief Parameters of a synthetic allocation workload.
+ *
+ * Sizes and lifetimes are drawn independently for every allocation. Lifetimes are measured in operations.
+ */
+struct WorkloadConfig {
+
+    enum class SizeDistribution {
+
+        // Uniform in [minSize, maxSize]
+        Uniform,
+        // Bounded Pareto in [minSize, maxSize], many small and few very large allocations
+        PowerLaw,
+        // Small sizes around minSize and, with probability largeFraction, large sizes around maxSize
+        Bimodal,
+        // Only the sizes in fixedSizes, picked with the given weights, like a program with a few object types
+        FixedMix
+    };
+
+    enum class LifetimeDistribution {
+
+        // Exponentially distributed with mean shortLifetime
+        Short,
+        // Exponentially distributed with mean longLifetime for a fraction of longFraction, shortLifetime otherwise
+        Long,
+        // Alternates between Short and Long every phaseLength operations
+        PhaseChange
+    };
+
+    SizeDistribution sizes = SizeDistribution::Uniform;
+    size_t minSize = 16;
+    size_t maxSize = 16384;
+    double powerLawExponent = 1.2;
+    double largeFraction = 0.05;
+    std::vector<std::pair<size_t, double>> fixedSizes = {{32, 4.0}, {48, 2.0}, {128, 1.0}, {1024, 0.25}};
+
+    LifetimeDistribution lifetimes = LifetimeDistribution::Long;
+    double shortLifetime = 100.0;
+    double longLifetime = 100000.0;
+    double longFraction = 0.1;
+    uint64_t phaseLength = 10000000;
+
+    // Operations of the three phases: allocations only, allocations and frees following the lifetimes, frees only
+    uint64_t rampOperations = 100000;
+    uint64_t steadyOperations = 100000000;
+    uint64_t drainOperations = UINT64_MAX;
+
+    uint64_t seed = 1;
+};
+
+
+/* @brief Generates a deterministic stream of allocate and free operations from a WorkloadConfig.
+ *
+ * The ramp phase only allocates, its objects die after the ramp according to their lifetimes.
+ * The steady phase frees every object whose lifetime has ended and allocates one new object per operation otherwise.
+ * The drain phase frees the remaining objects in the order they die, until none are left or the drain operations are used up.
+ * Objects are identified by small ids that are reused after the object was freed, so drivers can keep them in a vector.
+ *
+ * @class
+ */
+class Workload {
+
+public:
+
+    enum class Phase { Ramp, Steady, Drain, Done };
+
+    struct Operation {
+
+        bool allocate;
+        size_t id;
+        size_t size;
+    };
+
+    Workload() = delete;
+
+    /* @brief Constructor that seeds the random number generator.
+     *
+     * @param config    Parameters of the workload.
+     */
+    explicit Workload(const WorkloadConfig &config);
+
+    /* @brief Generates the next operation.
+     *
+     * @param op    The generated operation.
+     *
+     * @return False if the workload is done and op was not written.
+     */
+    bool Next(Operation &op);
+
+    Phase       phase()         const { return mPhase;}
+    uint64_t    operations()    const { return mOperations;}
+    size_t      liveObjects()   const { return mDeaths.size();}
+    // Upper bound of all ids handed out so far
+    size_t      maxId()         const { return mNextId;}
+
+
+private:
+
+    /* @brief Draws the size of a new allocation.
+     */
+    size_t DrawSize();
+
+    /* @brief Draws the lifetime of a new allocation in operations.
+     */
+    uint64_t DrawLifetime();
+
+    /* @brief Creates an allocate operation for a new object that dies lifetime operations after start.
+     *
+     * @param op    The generated operation.
+     * @param start    The operation from which the lifetime is counted.
+     */
+    void Allocate(Operation &op, const uint64_t start);
+
+    /* @brief Creates a free operation for the object that dies first.
+     *
+     * @param op    The generated operation.
+     */
+    void Free(Operation &op);
+
+
+    WorkloadConfig mConfig;
+    Phase mPhase;
+    uint64_t mOperations;
+
+    std::mt19937_64 mRandom;
+    std::uniform_real_distribution<double> mUniform;
+    std::discrete_distribution<size_t> mFixedSizes;
+
+    // Live objects as (death, id), ordered by death
+    std::priority_queue<std::pair<uint64_t, size_t>, std::vector<std::pair<uint64_t, size_t>>, std::greater<>> mDeaths;
+    std::vector<size_t> mFreeIds;
+    size_t mNextId;
+};